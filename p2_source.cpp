@@ -1,833 +1,6000 @@
-// Include standard headers
-#include <stdio.h>
-#include <stdlib.h>
-#include <vector>
-#include <array>
-#include <stack>   
-#include <sstream>
-// Include GLEW
-#include <GL/glew.h>
-// Include GLFW
-#include <GLFW/glfw3.h>
-// Include GLM
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/quaternion.hpp>
-#include <glm/gtx/quaternion.hpp>
-using namespace glm;
-// Include AntTweakBar
-#include <AntTweakBar.h>
-
-#include <common/shader.hpp>
-#include <common/controls.hpp>
-#include <common/objloader.hpp>
-#include <common/vboindexer.hpp>
-
-const int window_width = 1024, window_height = 768;
-
-typedef struct Vertex {
-	float Position[4];
-	float Color[4];
-	float Normal[3];
-	void SetPosition(float *coords) {
-		Position[0] = coords[0];
-		Position[1] = coords[1];
-		Position[2] = coords[2];
-		Position[3] = 1.0;
-	}
-	void SetColor(float *color) {
-		Color[0] = color[0];
-		Color[1] = color[1];
-		Color[2] = color[2];
-		Color[3] = color[3];
-	}
-	void SetNormal(float *coords) {
-		Normal[0] = coords[0];
-		Normal[1] = coords[1];
-		Normal[2] = coords[2];
-	}
-};
-
-// function prototypes
-int initWindow(void);
-void initOpenGL(void);
-void createVAOs(Vertex[], GLushort[], int);
-void loadObject(char*, glm::vec4, Vertex* &, GLushort* &, int);
-void createObjects(void);
-void pickObject(void);
-void renderScene(void);
-void cleanup(void);
-static void keyCallback(GLFWwindow*, int, int, int, int);
-static void mouseCallback(GLFWwindow*, int, int, int);
-
-void projectile(void);
-void key_up(void);
-void teleport(float, float);
-void key_down(void);
-void key_left(void);
-void key_right(void);
-
-// GLOBAL VARIABLES
-GLFWwindow* window;
-
-glm::mat4 gProjectionMatrix;
-glm::mat4 gViewMatrix;
-
-GLuint gPickedIndex = -1;
-std::string gMessage;
-
-GLuint programID;
-GLuint pickingProgramID;
-
-const GLuint NumObjects = 10;	// ATTN: THIS NEEDS TO CHANGE AS YOU ADD NEW OBJECTS
-GLuint VertexArrayId[NumObjects];
-GLuint VertexBufferId[NumObjects];
-GLuint IndexBufferId[NumObjects];
-
-// TL
-size_t VertexBufferSize[NumObjects];
-size_t IndexBufferSize[NumObjects];
-size_t NumIdcs[NumObjects];
-size_t NumVerts[NumObjects];
-
-GLuint MatrixID;
-GLuint ModelMatrixID;
-GLuint ViewMatrixID;
-GLuint ProjMatrixID;
-GLuint PickingMatrixID;
-GLuint pickingColorID;
-GLuint LightID;
-
-// Declare global objects
-// TL
-const size_t CoordVertsCount = 6;
-const size_t GridVertsCount = 44;
-Vertex CoordVerts[CoordVertsCount];
-Vertex GridVerts[GridVertsCount];
-
-char selection = 'C';
-bool shift_press = false;
-bool animate = false;
-float pointY = 0.0f;
-const float PI = 3.14159265;
-
-//transformation variables
-float trans_base_x = 0.0f;
-float trans_base_z = 0.0f;
-float rot_camera_side = PI/4;
-float rot_camera_up = PI/3;
-float rot_pen_long = 0.0f;
-float rot_pen_lat = 0.0f;
-float rot_pen_twist = 0.0f;
-float rot_arm2 = 0.0f;
-float rot_arm1 = 0.0f;
-float rot_top = 0.0f;
-
-int initWindow(void) {
-	// Initialise GLFW
-	if (!glfwInit()) {
-		fprintf(stderr, "Failed to initialize GLFW\n");
-		return -1;
-	}
-
-	glfwWindowHint(GLFW_SAMPLES, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	//glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);	// FOR MAC
-
-	// Open a window and create its OpenGL context
-	window = glfwCreateWindow(window_width, window_height, "Fohrman, Kyle (UFID 0514-1178)", NULL, NULL);
-	if (window == NULL) {
-		fprintf(stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version of the tutorials.\n");
-		glfwTerminate();
-		return -1;
-	}
-	glfwMakeContextCurrent(window);
-
-	// Initialize GLEW
-	glewExperimental = true; // Needed for core profile
-	if (glewInit() != GLEW_OK) {
-		fprintf(stderr, "Failed to initialize GLEW\n");
-		return -1;
-	}
-
-	// Initialize the GUI
-	TwInit(TW_OPENGL_CORE, NULL);
-	TwWindowSize(window_width, window_height);
-	TwBar * GUI = TwNewBar("Picking");
-	TwSetParam(GUI, NULL, "refresh", TW_PARAM_CSTRING, 1, "0.1");
-	TwAddVarRW(GUI, "Last picked object", TW_TYPE_STDSTRING, &gMessage, NULL);
-
-	// Set up inputs
-	glfwSetCursorPos(window, window_width / 2, window_height / 2);
-	glfwSetKeyCallback(window, keyCallback);
-	glfwSetMouseButtonCallback(window, mouseCallback);
-
-	return 0;
-}
-
-void initOpenGL(void) {
-	// Enable depth test
-	glEnable(GL_DEPTH_TEST);
-	// Accept fragment if it closer to the camera than the former one
-	glDepthFunc(GL_LESS);
-	// Cull triangles which normal is not towards the camera
-	glEnable(GL_CULL_FACE);
-
-	// Projection matrix : 45 Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
-	gProjectionMatrix = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
-	// Or, for an ortho camera :
-	//gProjectionMatrix = glm::ortho(-4.0f, 4.0f, -3.0f, 3.0f, 0.0f, 100.0f); // In world coordinates
-
-	// Camera matrix
-	gViewMatrix = glm::lookAt(glm::vec3(10.0, 10.0, 10.0f),	// eye
-		glm::vec3(0.0, 0.0, 0.0),	// center
-		glm::vec3(0.0, 1.0, 0.0));	// up
-
-	// Create and compile our GLSL program from the shaders
-	programID = LoadShaders("StandardShading.vertexshader", "StandardShading.fragmentshader");
-	pickingProgramID = LoadShaders("Picking.vertexshader", "Picking.fragmentshader");
-
-	// Get a handle for our "MVP" uniform
-	MatrixID = glGetUniformLocation(programID, "MVP");
-	ModelMatrixID = glGetUniformLocation(programID, "M");
-	ViewMatrixID = glGetUniformLocation(programID, "V");
-	ProjMatrixID = glGetUniformLocation(programID, "P");
-
-	PickingMatrixID = glGetUniformLocation(pickingProgramID, "MVP");
-	// Get a handle for our "pickingColorID" uniform
-	pickingColorID = glGetUniformLocation(pickingProgramID, "PickingColor");
-	// Get a handle for our "LightPosition" uniform
-	LightID = glGetUniformLocation(programID, "LightPosition_worldspace");
-
-	// TL
-	// Define objects
-	createObjects();
-
-	// ATTN: create VAOs for each of the newly created objects here:
-	VertexBufferSize[0] = sizeof(CoordVerts);
-	VertexBufferSize[1] = sizeof(GridVerts);
-	NumVerts[0] = CoordVertsCount;
-	NumVerts[1] = GridVertsCount;
-
-	createVAOs(CoordVerts, NULL, 0);
-	createVAOs(GridVerts, NULL, 1);
-}
-
-void createVAOs(Vertex Vertices[], unsigned short Indices[], int ObjectId) {
-	GLenum ErrorCheckValue = glGetError();
-	const size_t VertexSize = sizeof(Vertices[0]);
-	const size_t RgbOffset = sizeof(Vertices[0].Position);
-	const size_t Normaloffset = sizeof(Vertices[0].Color) + RgbOffset;
-
-	// Create Vertex Array Object
-	glGenVertexArrays(1, &VertexArrayId[ObjectId]);
-	glBindVertexArray(VertexArrayId[ObjectId]);
-
-	// Create Buffer for vertex data
-	glGenBuffers(1, &VertexBufferId[ObjectId]);
-	glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[ObjectId]);
-	glBufferData(GL_ARRAY_BUFFER, VertexBufferSize[ObjectId], Vertices, GL_STATIC_DRAW);
-
-	// Create Buffer for indices
-	if (Indices != NULL) {
-		glGenBuffers(1, &IndexBufferId[ObjectId]);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBufferId[ObjectId]);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndexBufferSize[ObjectId], Indices, GL_STATIC_DRAW);
-	}
-
-	// Assign vertex attributes
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, VertexSize, 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, VertexSize, (GLvoid*)RgbOffset);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VertexSize, (GLvoid*)Normaloffset);	// TL
-
-	glEnableVertexAttribArray(0);	// position
-	glEnableVertexAttribArray(1);	// color
-	glEnableVertexAttribArray(2);	// normal
-
-	// Disable our Vertex Buffer Object 
-	glBindVertexArray(0);
-
-	ErrorCheckValue = glGetError();
-	if (ErrorCheckValue != GL_NO_ERROR)
-	{
-		fprintf(
-			stderr,
-			"ERROR: Could not create a VBO: %s \n",
-			gluErrorString(ErrorCheckValue)
-		);
-	}
-}
-
-// Ensure your .obj files are in the correct format and properly loaded by looking at the following function
-void loadObject(char* file, glm::vec4 color, Vertex* &out_Vertices, GLushort* &out_Indices, int ObjectId) {
-	// Read our .obj file
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec2> uvs;
-	std::vector<glm::vec3> normals;
-	bool res = loadOBJ(file, vertices, normals);
-
-	std::vector<GLushort> indices;
-	std::vector<glm::vec3> indexed_vertices;
-	std::vector<glm::vec2> indexed_uvs;
-	std::vector<glm::vec3> indexed_normals;
-	indexVBO(vertices, normals, indices, indexed_vertices, indexed_normals);
-
-	const size_t vertCount = indexed_vertices.size();
-	const size_t idxCount = indices.size();
-
-	// populate output arrays
-	out_Vertices = new Vertex[vertCount];
-	for (int i = 0; i < vertCount; i++) {
-		out_Vertices[i].SetPosition(&indexed_vertices[i].x);
-		out_Vertices[i].SetNormal(&indexed_normals[i].x);
-		out_Vertices[i].SetColor(&color[0]);
-	}
-	out_Indices = new GLushort[idxCount];
-	for (int i = 0; i < idxCount; i++) {
-		out_Indices[i] = indices[i];
-	}
-
-	// set global variables!!
-	NumIdcs[ObjectId] = idxCount;
-	VertexBufferSize[ObjectId] = sizeof(out_Vertices[0]) * vertCount;
-	IndexBufferSize[ObjectId] = sizeof(GLushort) * idxCount;
-}
-
-void createObjects(void) {
-	//-- COORDINATE AXES --//
-	CoordVerts[0] = { { 0.0, 0.0, 0.0, 1.0 }, { 1.0, 0.0, 0.0, 1.0 }, { 0.0, 0.0, 1.0 } };
-	CoordVerts[1] = { { 5.0, 0.0, 0.0, 1.0 }, { 1.0, 0.0, 0.0, 1.0 }, { 0.0, 0.0, 1.0 } };
-	CoordVerts[2] = { { 0.0, 0.0, 0.0, 1.0 }, { 0.0, 1.0, 0.0, 1.0 }, { 0.0, 0.0, 1.0 } };
-	CoordVerts[3] = { { 0.0, 5.0, 0.0, 1.0 }, { 0.0, 1.0, 0.0, 1.0 }, { 0.0, 0.0, 1.0 } };
-	CoordVerts[4] = { { 0.0, 0.0, 0.0, 1.0 }, { 0.0, 0.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
-	CoordVerts[5] = { { 0.0, 0.0, 5.0, 1.0 }, { 0.0, 0.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
-	
-	//-- GRID --//
-	
-	for (int i = 0; i < 11; i++)
-	{
-		float xcoord = -5.0 + i;
-		GridVerts[2 * i] = { { xcoord, 0.0, -5.0, 1.0 }, { 1.0, 1.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
-		GridVerts[2 * i + 1] = { { xcoord, 0.0, 5.0, 1.0 }, { 1.0, 1.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
-	}
-	for (int i = 11; i < 22; i++)
-	{
-		float zcoord = -5.0 + (i - 11);
-		GridVerts[2 * i] = { { -5.0, 0.0, zcoord, 1.0 }, { 1.0, 1.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
-		GridVerts[2 * i + 1] = { { 5.0, 0.0, zcoord, 1.0 }, { 1.0, 1.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
-	}
-	
-	//-- .OBJs --//
-
-	// ATTN: Load your models here through .obj files -- example of how to do so is as shown
-	
-	Vertex* Verts;
-	GLushort* Idcs;
-
-	//truncated tetrahedron base, red
-	if(selection == 'B') loadObject("base.obj", glm::vec4(1.0, 0.0, 0.0, 1.0), Verts, Idcs, 2);
-	else loadObject("base.obj", glm::vec4(0.8, 0.0, 0.0, 1.0), Verts, Idcs, 2);
-	createVAOs(Verts, Idcs, 2);
-
-	//ico sphere top, green
-	if (selection == 'T') loadObject("top.obj", glm::vec4(0.0, 1.0, 0.0, 1.0), Verts, Idcs, 3);
-	else loadObject("top.obj", glm::vec4(0.0, 0.8, 0.0, 1.0), Verts, Idcs, 3);
-	createVAOs(Verts, Idcs, 3);
-
-	//rectangular prism arm1, blue, length 2 * scale
-	if (selection == '1') loadObject("arm1.obj", glm::vec4(0.0, 0.0, 1.0, 1.0), Verts, Idcs, 4);
-	else loadObject("arm1.obj", glm::vec4(0.0, 0.0, 0.8, 1.0), Verts, Idcs, 4);
-	createVAOs(Verts, Idcs, 4);
-
-	//dodecahedron joint, purple
-	loadObject("joint.obj", glm::vec4(1.0, 0.0, 1.0, 1.0), Verts, Idcs, 5);
-	createVAOs(Verts, Idcs, 5);
-
-	//cylinder arm2, cyan, length 2 * scale
-	if (selection == '2') loadObject("arm2.obj", glm::vec4(0.8, 1.0, 1.0, 1.0), Verts, Idcs, 6);
-	else loadObject("arm2.obj", glm::vec4(0.0, 1.0, 1.0, 1.0), Verts, Idcs, 6);
-	createVAOs(Verts, Idcs, 6);
-
-	//truncated octahedron pen, yellow
-	if (selection == 'P') loadObject("pen.obj", glm::vec4(1.0, 1.0, 0.0, 1.0), Verts, Idcs, 7);
-	else loadObject("pen.obj", glm::vec4(0.8, 0.8, 0.0, 1.0), Verts, Idcs, 7);
-	createVAOs(Verts, Idcs, 7);
-
-	//cube button, red
-	loadObject("button.obj", glm::vec4(1.0, 0.0, 0.0, 1.0), Verts, Idcs, 8);
-	createVAOs(Verts, Idcs, 8);
-
-	//solid projectile icosahedron, white
-	loadObject("solid.obj", glm::vec4(1.0, 1.0, 1.0, 1.0), Verts, Idcs, 9);
-	createVAOs(Verts, Idcs, 9);
-	
-}
-
-void pickObject(void) {
-	// Clear the screen in white
-	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glUseProgram(pickingProgramID);
-	{
-		glm::mat4 ModelMatrix = glm::mat4(1.0); // TranslationMatrix * RotationMatrix;
-		glm::mat4 MVP = gProjectionMatrix * gViewMatrix * ModelMatrix;
-
-		// Send our transformation to the currently bound shader, in the "MVP" uniform
-		glUniformMatrix4fv(PickingMatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		// ATTN: DRAW YOUR PICKING SCENE HERE. REMEMBER TO SEND IN A DIFFERENT PICKING COLOR FOR EACH OBJECT BEFOREHAND
-		glBindVertexArray(0);
-	}
-	glUseProgram(0);
-	// Wait until all the pending drawing commands are really done.
-	// Ultra-mega-over slow ! 
-	// There are usually a long time between glDrawElements() and
-	// all the fragments completely rasterized.
-	glFlush();
-	glFinish();
-
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-	// Read the pixel at the center of the screen.
-	// You can also use glfwGetMousePos().
-	// Ultra-mega-over slow too, even for 1 pixel, 
-	// because the framebuffer is on the GPU.
-	double xpos, ypos;
-	glfwGetCursorPos(window, &xpos, &ypos);
-	unsigned char data[4];
-	glReadPixels(xpos, window_height - ypos, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, data); // OpenGL renders with (0,0) on bottom, mouse reports with (0,0) on top
-
-	// Convert the color back to an integer ID
-	gPickedIndex = int(data[0]);
-
-	if (gPickedIndex == 255) { // Full white, must be the background !
-		gMessage = "background";
-	}
-	else {
-		std::ostringstream oss;
-		oss << "point " << gPickedIndex;
-		gMessage = oss.str();
-	}
-
-	// Uncomment these lines to see the picking shader in effect
-	//glfwSwapBuffers(window);
-	//continue; // skips the normal rendering
-}
-
-void renderScene(void) {
-	//ATTN: DRAW YOUR SCENE HERE. MODIFY/ADAPT WHERE NECESSARY!
-
-	// Dark blue background
-	glClearColor(0.0f, 0.0f, 0.2f, 0.0f);
-	// Re-clear the screen for real rendering
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glUseProgram(programID);
-	{
-		/* Camera rotations
-		x = r * cos(latitudeAngle) * sin(longitudeAngle)
-		y = r * cos(longitudeAngle
-		z = r * sin(latitudeAngle) * sin(longitudeAngle)
-		*/
-		float x_cam, y_cam, z_cam, radius;
-		radius = sqrt(300);
-		x_cam = radius * cos(rot_camera_side) * sin(rot_camera_up);
-		y_cam = radius * cos(rot_camera_up);
-		z_cam = radius * sin(rot_camera_side) * sin(rot_camera_up);
-		gViewMatrix = glm::lookAt(glm::vec3(x_cam, y_cam, z_cam),	// eye
-			glm::vec3(0.0, 0.0, 0.0),	// center
-			glm::vec3(0.0, 1.0, 0.0));	// up
-
-		glm::vec3 lightPos = glm::vec3(4, 4, 4);
-		glm::mat4x4 ModelMatrix = glm::mat4(1.0);
-		glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-
-		glBindVertexArray(VertexArrayId[0]);	// Draw CoordAxes
-		glDrawArrays(GL_LINES, 0, NumVerts[0]);
-
-		glBindVertexArray(VertexArrayId[1]); //Draw Grid
-		glDrawArrays(GL_LINES, 0, NumVerts[1]);
-
-		float scale = 1.0f;
-
-		glm::mat4 myScalingMatrix = glm::scale(ModelMatrix, glm::vec3(scale, scale, scale));
-		ModelMatrix = myScalingMatrix * ModelMatrix;
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-
-		//base
-		ModelMatrix = glm::translate(ModelMatrix, glm::vec3(trans_base_x, 0.0f, trans_base_z));
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		glBindVertexArray(VertexArrayId[2]);
-		glDrawElements(GL_TRIANGLES, NumIdcs[2], GL_UNSIGNED_SHORT, (void*)0);
-
-		//top
-		glm::vec3 topRotationAxis(0.0f, 1.0f, 0.0f);
-		ModelMatrix = glm::rotate(ModelMatrix, rot_top, topRotationAxis);
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-
-		ModelMatrix = translate(ModelMatrix, glm::vec3(0.0f, 1.6, 0.0f));
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		glBindVertexArray(VertexArrayId[3]);
-		glDrawElements(GL_TRIANGLES, NumIdcs[3], GL_UNSIGNED_SHORT, (void*)0);
-
-		//arm1
-		glm::vec3 arm1RotationAxis(0.0f, 0.0f, 1.0f);
-		glm::mat4 JointMatrix = ModelMatrix;
-		glm::mat4 PenMatrix = ModelMatrix;
-		ModelMatrix = glm::rotate(ModelMatrix, rot_arm1, arm1RotationAxis);
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		glBindVertexArray(VertexArrayId[4]);
-		glDrawElements(GL_TRIANGLES, NumIdcs[4], GL_UNSIGNED_SHORT, (void*)0);
-
-		//joint
-		ModelMatrix = translate(ModelMatrix, glm::vec3(0.0f, 2.0, 0.0f));
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-
-		/*ModelMatrix = glm::rotate(ModelMatrix, rot_arm1, arm1RotationAxis);
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);*/
-		glBindVertexArray(VertexArrayId[5]);
-		glDrawElements(GL_TRIANGLES, NumIdcs[5], GL_UNSIGNED_SHORT, (void*)0);
-
-		//arm2
-		ModelMatrix = glm::rotate(ModelMatrix, rot_arm2, arm1RotationAxis);
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		glBindVertexArray(VertexArrayId[6]);
-		glDrawElements(GL_TRIANGLES, NumIdcs[6], GL_UNSIGNED_SHORT, (void*)0);
-
-		//pen
-		ModelMatrix = translate(ModelMatrix, glm::vec3(0.0f, 1.8f, 0.0f));
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-
-		glm::vec3 xRotationAxis(1.0f, 0.0f, 0.0f);
-		glm::vec3 yRotationAxis(0.0f, 1.0f, 0.0f);
-		glm::vec3 zRotationAxis(0.0f, 0.0f, 1.0f);
-		ModelMatrix = glm::rotate(ModelMatrix, rot_pen_long, xRotationAxis);
-		ModelMatrix = glm::rotate(ModelMatrix, rot_pen_lat, zRotationAxis);
-		ModelMatrix = glm::rotate(ModelMatrix, rot_pen_twist, yRotationAxis);
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		glBindVertexArray(VertexArrayId[7]);
-		glDrawElements(GL_TRIANGLES, NumIdcs[7], GL_UNSIGNED_SHORT, (void*)0);
-
-		//solid matrix
-		glm::mat4 SolidMatrix = translate(ModelMatrix, glm::vec3(0.0f, -0.4f, 0.0f));
-
-		//button
-		ModelMatrix = glm::translate(ModelMatrix, glm::vec3(-0.2f, 0.6, 0.0f));
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		glBindVertexArray(VertexArrayId[8]);
-		glDrawElements(GL_TRIANGLES, NumIdcs[8], GL_UNSIGNED_SHORT, (void*)0);
-
-		//solid
-		ModelMatrix = SolidMatrix;
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-		glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-
-		if (animate == true)
-		{
-			ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.0f, -0.1f, 0.0f));
-			glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &gViewMatrix[0][0]);
-			glUniformMatrix4fv(ProjMatrixID, 1, GL_FALSE, &gProjectionMatrix[0][0]);
-			glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-			glBindVertexArray(VertexArrayId[9]);
-			glDrawElements(GL_TRIANGLES, NumIdcs[9], GL_UNSIGNED_SHORT, (void*)0);
-
-			if (ModelMatrix[3].y <= 0.0f)
-			{
-				animate = false;
-				teleport(ModelMatrix[3].x, ModelMatrix[3].z);
-			}
-		}
-
-		glBindVertexArray(0);
-	}
-	glUseProgram(0);
-	// Draw GUI
-	TwDraw();
-
-	// Swap buffers
-	glfwSwapBuffers(window);
-	glfwPollEvents();
-}
-
-void cleanup(void) {
-	// Cleanup VBO and shader
-	for (int i = 0; i < NumObjects; i++) {
-		glDeleteBuffers(1, &VertexBufferId[i]);
-		glDeleteBuffers(1, &IndexBufferId[i]);
-		glDeleteVertexArrays(1, &VertexArrayId[i]);
-	}
-	glDeleteProgram(programID);
-	glDeleteProgram(pickingProgramID);
-
-	// Close OpenGL window and terminate GLFW
-	glfwTerminate();
-}
-
-// Alternative way of triggering functions on keyboard events
-static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-	// ATTN: MODIFY AS APPROPRIATE
-	if (action == GLFW_PRESS) {
-		switch (key)
-		{
-		case GLFW_KEY_C:
-			selection = 'C';
-			createObjects();
-			break;
-		case GLFW_KEY_P:
-			selection = 'P';
-			createObjects();
-			break;
-		case GLFW_KEY_B:
-			selection = 'B';
-			createObjects();
-			break;
-		case GLFW_KEY_T:
-			selection = 'T';
-			createObjects();
-			break;
-		case GLFW_KEY_S:
-			selection = 'S';
-			createObjects();
-			projectile();
-			break;
-		case GLFW_KEY_1:
-			selection = '1';
-			createObjects();
-			break;
-		case GLFW_KEY_2:
-			selection = '2';
-			createObjects();
-			break;
-		case GLFW_KEY_LEFT_SHIFT:
-			shift_press = true;
-			break;
-		case GLFW_KEY_RIGHT_SHIFT:
-			shift_press = true;
-			break;
-		case GLFW_KEY_UP:
-			key_up();
-			break;
-		case GLFW_KEY_DOWN:
-			key_down();
-			break;
-		case GLFW_KEY_LEFT:
-			key_left();
-			break;
-		case GLFW_KEY_RIGHT:
-			key_right();
-			break;
-		default:
-			break;
-		}
-		renderScene();
-	}
-	if (action == GLFW_RELEASE) {
-		switch (key)
-		{
-		case GLFW_KEY_LEFT_SHIFT:
-			shift_press = false;
-			break;
-		case GLFW_KEY_RIGHT_SHIFT:
-			shift_press = false;
-			break;
-		default:
-			break;
-		}
-	}
-}
-
-void projectile() {
-	animate = true;
-	
-	/*while (animate == true)
-	{
-		pointY += 0.1f;
-		renderScene();
-	}*/
-}
-
-void teleport(float x, float z) {
-	trans_base_x = x;
-	trans_base_z = z;
-
-	renderScene();
-}
-
-
-
-void key_up() {
-	switch (selection)
-	{
-	case 'C':
-		if (rot_camera_up > PI / 10) rot_camera_up -= PI / 10;
-		break;
-	case 'B':
-		trans_base_x -= 0.1;
-		break;
-	case 'T':
-		break;
-	case '1':
-		if (rot_arm1 <= (3 * PI / 4)) rot_arm1 += PI / 10;
-		break;
-	case '2':
-		rot_arm2 += PI / 10;
-		break;
-	case 'P':
-		rot_pen_lat += PI / 10;
-		break;
-	default:
-		break;
-	}
-}
-
-void key_down() {
-	switch (selection)
-	{
-	case 'C':
-		if (rot_camera_up < 9 * PI / 10) rot_camera_up += PI / 10;
-		break;
-	case 'B':
-		trans_base_x += 0.1;
-		break;
-	case 'T':
-		break;
-	case '1':
-		if (rot_arm1 >= (-3 * PI / 4)) rot_arm1 -= PI / 10;
-		break;
-	case '2':
-		rot_arm2 -= PI / 10;
-		break;
-	case 'P':
-		rot_pen_lat -= PI / 10;
-		break;
-	default:
-		break;
-	}
-}
-
-void key_left() {
-	switch (selection)
-	{
-	case 'C':
-		rot_camera_side -= PI/10;
-		break;
-	case 'B':
-		trans_base_z += 0.1;
-		break;
-	case 'T':
-		rot_top -= PI / 10;
-		break;
-	case '1':
-		break;
-	case '2':
-		break;
-	case 'P':
-		if (shift_press == true) rot_pen_twist -= PI / 10;
-		else rot_pen_long -= PI / 10;
-		break;
-	default:
-		break;
-	}
-}
-
-void key_right() {
-	switch (selection)
-	{
-	case 'C':
-		rot_camera_side += PI/10;
-		break;
-	case 'B':
-		trans_base_z -= 0.1;
-		break;
-	case 'T':
-		rot_top += PI / 10;
-		break;
-	case '1':
-		break;
-	case '2':
-		break;
-	case 'P':
-		if (shift_press == true) rot_pen_twist += PI / 10;
-		else rot_pen_long += PI / 10;
-		break;
-	default:
-		break;
-	}
-}
-
-// Alternative way of triggering functions on mouse click events
-static void mouseCallback(GLFWwindow* window, int button, int action, int mods) {
-	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
-		pickObject();
-	}
-}
-
-int main(void) {
-	// TL
-	// ATTN: Refer to https://learnopengl.com/Getting-started/Transformations, https://learnopengl.com/Getting-started/Coordinate-Systems,
-	// and https://learnopengl.com/Getting-started/Camera to familiarize yourself with implementing the camera movement
-
-	// ATTN (Project 3 only): Refer to https://learnopengl.com/Getting-started/Textures to familiarize yourself with mapping a texture
-	// to a given mesh
-
-	// Initialize window
-	int errorCode = initWindow();
-	if (errorCode != 0)
-		return errorCode;
-
-	// Initialize OpenGL pipeline
-	initOpenGL();
-
-	// For speed computation
-	double lastTime = glfwGetTime();
-	int nbFrames = 0;
-	do {
-		// Measure speed
-		double currentTime = glfwGetTime();
-		nbFrames++;
-		if (currentTime - lastTime >= 1.0){ // If last prinf() was more than 1sec ago
-			printf("%f ms/frame\n", 1000.0 / double(nbFrames));
-			nbFrames = 0;
-			lastTime += 1.0;
-		}
-
-		// DRAWING POINTS
-		renderScene();
-
-	} // Check if the ESC key was pressed or the window was closed
-	while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
-	glfwWindowShouldClose(window) == 0);
-
-	cleanup();
-
-	return 0;
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <float.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <vector>
+#include <array>
+#include <stack>   
+#include <sstream>
+#include <map>
+#include <queue>
+#include <deque>
+#include <chrono>
+#include <charconv>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+#include <algorithm>
+#include <new>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+// Include GLEW
+#include <GL/glew.h>
+// Include GLFW
+#include <GLFW/glfw3.h>
+// EGL for the headless benchmark mode; build with -DHEADLESS_EGL and link libEGL
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/quaternion.hpp>
+using namespace glm;
+// Include AntTweakBar
+#include <AntTweakBar.h>
+
+#include <common/shader.hpp>
+#include <common/controls.hpp>
+#include <common/objloader.hpp>
+#include <common/vboindexer.hpp>
+
+const int window_width = 1024, window_height = 768;
+
+// Headless mode renders into an offscreen framebuffer on a surfaceless EGL context and drives
+// time from the frame counter instead of the wall clock
+bool Headless = false;
+double HeadlessClock = 0.0;
+const double HeadlessFrameRate = 60.0;
+GLuint HeadlessFramebuffer;
+GLuint HeadlessRenderbuffers[2];	// color, depth
+#ifdef HEADLESS_EGL
+EGLDisplay HeadlessDisplay = EGL_NO_DISPLAY;
+EGLContext HeadlessContext = EGL_NO_CONTEXT;
+#endif
+
+typedef struct Vertex {
+	float Position[4];
+	float Color[4];
+	float Normal[3];
+	void SetPosition(float *coords) {
+		Position[0] = coords[0];
+		Position[1] = coords[1];
+		Position[2] = coords[2];
+		Position[3] = 1.0;
+	}
+	void SetColor(float *color) {
+		Color[0] = color[0];
+		Color[1] = color[1];
+		Color[2] = color[2];
+		Color[3] = color[3];
+	}
+	void SetNormal(float *coords) {
+		Normal[0] = coords[0];
+		Normal[1] = coords[1];
+		Normal[2] = coords[2];
+	}
+};
+
+// Mesh vertex as uploaded, 12 bytes instead of the 44 of Vertex: the position is 16-bit within the
+// mesh bounds (dequantized by PositionScale/PositionBias of the draw, the fourth value only pads to
+// 4-byte alignment) and the normal is signed 2_10_10_10. Colors come from the per-draw uniforms.
+struct PackedVertex {
+	GLushort Position[4];
+	GLuint Normal;
+};
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex must stay tightly packed");
+
+// Levels of detail of one mesh: ranges of its index buffer over the same vertices, level 0 is the
+// full mesh. Error is the largest model-space distance the simplification moved the surface by.
+const int MaxLods = 4;
+
+struct MeshLods {
+	unsigned int Count;
+	unsigned int First[MaxLods];	// first index of each level
+	unsigned int Indices[MaxLods];	// index count of each level
+	float Error[MaxLods];
+};
+
+// Binary mesh (.mbin) file: MeshFileHeader, then PackedVertex[NumVertices], then GLushort[NumIndices]
+// holding every level of detail back to back.
+// Written by --convert, memory-mapped by the viewer and handed straight to glBufferData.
+const unsigned int MeshFileMagic = 0x4E49424D;	// "MBIN"
+const unsigned int MeshFileVersion = 3;
+
+struct MeshFileHeader {
+	unsigned int Magic;
+	unsigned int Version;
+	unsigned int VertexSize;	// PackedVertex layout, must match this build
+	unsigned int PositionOffset;
+	unsigned int NormalType;	// GL_INT_2_10_10_10_REV
+	unsigned int NormalOffset;
+	unsigned int IndexSize;
+	unsigned int NumVertices;
+	unsigned int NumIndices;
+	float BoundsMin[3];	// quantization range of the positions
+	float BoundsMax[3];
+	MeshLods Lods;
+	unsigned long long SourceSize;	// size and modification time of the .obj it was built from
+	long long SourceTime;
+	unsigned long long Checksum;	// FNV-1a of the vertex and index data
+};
+
+struct MappedFile {
+	const unsigned char* Data;
+	size_t Size;
+#ifdef _WIN32
+	HANDLE File;
+	HANDLE Mapping;
+#else
+	int File;
+#endif
+};
+
+// Linear allocator for load-time scratch memory. Allocation bumps an offset and nothing is freed
+// until arenaReset(), which keeps the memory for the next load. A round that needed more than one
+// block leaves a single block of the peak size behind, so repeated loads stop touching the heap.
+struct ArenaBlock {
+	unsigned char* Data;
+	size_t Size;
+};
+
+struct LinearArena {
+	std::vector<ArenaBlock> Blocks;	// the last one is being filled
+	size_t Used;	// bytes of the last block
+	size_t RoundBytes;	// handed out since the last reset
+	size_t PeakBytes;
+};
+
+void* arenaAlloc(LinearArena &, size_t);
+void arenaReset(LinearArena &);
+void arenaRelease(LinearArena &);
+extern thread_local LinearArena* CurrentArena;
+
+// Scratch containers allocate from the arena that was current on their thread when they were
+// created (see ArenaScope), or from the heap outside of one. Freeing arena memory is a no-op.
+template <typename T> struct StagingAllocator {
+	typedef T value_type;
+	LinearArena* Arena;
+	StagingAllocator() : Arena(CurrentArena) {}
+	template <typename U> StagingAllocator(const StagingAllocator<U> &other) : Arena(other.Arena) {}
+	T* allocate(size_t n) { return Arena != NULL ? (T*)arenaAlloc(*Arena, n * sizeof(T)) : (T*)::operator new(n * sizeof(T)); }
+	void deallocate(T* p, size_t) { if (Arena == NULL) ::operator delete(p); }
+	template <typename U> bool operator==(const StagingAllocator<U> &other) const { return Arena == other.Arena; }
+	template <typename U> bool operator!=(const StagingAllocator<U> &other) const { return Arena != other.Arena; }
+};
+template <typename T> using StagingVector = std::vector<T, StagingAllocator<T> >;
+
+// Makes arena current on this thread for the scope, then resets it. Staging containers must not
+// outlive the scope they were created in.
+struct ArenaScope {
+	LinearArena &Arena;
+	LinearArena* Previous;
+	ArenaScope(LinearArena &arena) : Arena(arena), Previous(CurrentArena) { CurrentArena = &arena; }
+	~ArenaScope() { CurrentArena = Previous; arenaReset(Arena); }
+};
+
+// function prototypes
+int initWindow(void);
+int initHeadless(void);
+void shutdownHeadless(void);
+double viewerTime(void);
+int runHeadless(int, const char*, bool);
+void initOpenGL(void);
+GLuint loadProgram(void);
+void setupProgram(GLuint);
+void shareMesh(int, int);
+void startHotReload(void);
+void stopHotReload(void);
+void applyReloads(void);
+void createStagingRing(void);
+void startStreaming(void);
+void finishStreaming(void);
+void stopStreaming(void);
+void createVAOs(Vertex[], GLushort[], int);
+void setPackedVertexAttribs(void);
+typedef struct PreparedMesh PreparedMesh;
+void createMeshArena(void);
+void attachMeshArena(GLuint);
+void appendMeshArena(const PackedVertex*, const GLushort*, int);
+void copyMeshArena(size_t, int);
+void stageMesh(PreparedMesh &, const PackedVertex*, size_t, const GLushort*, size_t);
+void retireStagingRing(void);
+void packVertices(const StagingVector<glm::vec3> &, const StagingVector<glm::vec3> &, PackedVertex*, glm::vec3 &, glm::vec3 &);
+void setMeshBounds(int, const glm::vec3 &, const glm::vec3 &);
+glm::vec3 unpackPosition(const PackedVertex &, const glm::vec4 &, const glm::vec4 &);
+void computeMeshBounds(int, const PackedVertex*, size_t);
+void measureMesh(const PackedVertex*, size_t, const glm::vec4 &, const glm::vec4 &, glm::vec3 &, glm::vec3 &, glm::vec4 &);
+void extractFrustumPlanes(const glm::mat4 &);
+bool partVisible(int, const glm::mat4 &);
+bool parseObject(const char*, StagingVector<PackedVertex> &, StagingVector<GLushort> &, glm::vec3 &, glm::vec3 &, MeshLods &);
+void generateLods(const PackedVertex*, size_t, StagingVector<GLushort> &, const glm::vec4 &, const glm::vec4 &, MeshLods &);
+int selectLod(int, int, const glm::mat4 &);
+bool readBinaryMesh(const char*, PreparedMesh &);
+bool writeBinaryMesh(const char*);
+int convertMeshes(int, char**);
+std::string binaryMeshPath(const char*);
+void weldVertices(const glm::vec3*, const glm::vec3*, size_t, float, StagingVector<unsigned int> &, StagingVector<glm::vec3> &, StagingVector<glm::vec3> &);
+int benchWeld(int);
+int benchReload(int);
+typedef void (*ParallelJob)(void*, int);
+typedef struct WorkerPool WorkerPool;
+void runParallel(WorkerPool &, int, ParallelJob, void*, int);
+void stopWorkers(void);
+bool loadOBJParallel(const char*, StagingVector<glm::vec3> &, StagingVector<glm::vec3> &, int);
+int benchParse(const char*);
+bool mapFile(const char*, MappedFile &);
+void unmapFile(MappedFile &);
+unsigned long long fnv1a(const void*, size_t, unsigned long long);
+void loadMesh(const char*, int, glm::vec4, glm::vec4, char);
+glm::vec4 objectColor(int);
+typedef struct RenderList RenderList;
+int addDrawSlot(RenderList &, const glm::mat4 &, const glm::vec4 &, int);
+void uploadFrameUniforms(void);
+void setObjectIndex(int);
+void createObjects(void);
+typedef struct MeshBVH MeshBVH;
+typedef struct PickHit PickHit;
+void buildMeshBVH(MeshBVH &, const PackedVertex*, size_t, const GLushort*, size_t, const glm::vec4 &, const glm::vec4 &);
+bool intersectMeshBVH(const MeshBVH &, const glm::vec3 &, const glm::vec3 &, float &);
+void cursorRay(double, double, glm::vec3 &, glm::vec3 &);
+bool pickRay(const glm::vec3 &, const glm::vec3 &, PickHit &);
+void pickObject(void);
+int benchPick(void);
+typedef struct IKBatch IKBatch;
+void resizeIKBatch(IKBatch &, int);
+void solveIK(IKBatch &, float, float);
+bool loadTrajectory(const char*);
+int benchIK(int);
+int addNode(int, int);
+void createHierarchy(void);
+void buildHull(const std::vector<glm::vec3> &, std::vector<glm::vec3> &);
+int benchCollision(int);
+void createFleet(int);
+void createFleetVAO(void);
+void updateFleet(double);
+typedef struct JointState JointState;
+JointState currentJoints(void);
+void setJoints(const JointState &);
+void poseArm(const JointState &, glm::mat4*);
+bool armCollides(const JointState &);
+bool clampMove(const JointState &, JointState &);
+glm::mat4 jointLocalMatrix(int, const JointState &);
+glm::mat4 nodeMatrixFromState(int, const JointState &);
+void syncJointTransforms(const JointState &);
+void updateWorldTransforms(void);
+void prepareRenderList(RenderList &, double);
+void submitRenderList(RenderList &);
+void prepareNextFrame(double);
+void waitRenderList(void);
+void renderScene(void);
+void presentFrame(void);
+void initProfiler(void);
+void profileBegin(int);
+void profileEnd(int);
+void gpuTimerBegin(int);
+void gpuTimerEnd(void);
+void profileFrameEnd(void);
+bool writeTrace(const char*);
+void cleanup(void);
+static void keyCallback(GLFWwindow*, int, int, int, int);
+static void mouseCallback(GLFWwindow*, int, int, int);
+
+void projectile(void);
+void applyInput(int, int);
+void createProjectiles(void);
+void spawnProjectiles(int, const JointState &);
+void updateProjectiles(float);
+void startSimulation(void);
+void advanceSimulation(double);
+void stopSimulation(void);
+void interpolateSnapshots(double);
+typedef struct InputCommand InputCommand;
+bool pushCommand(const InputCommand &);
+void applyCommands(void);
+void replayInputs(void);
+bool loadRecording(const char*);
+void startRecording(void);
+bool writeRecording(const char*, const std::vector<double> &);
+void printReplayResult(const std::vector<double> &);
+void checkpointReplay(unsigned, const JointState &, float, float);
+void key_up(void);
+void key_down(void);
+void key_left(void);
+void key_right(void);
+
+// GLOBAL VARIABLES
+GLFWwindow* window;
+
+glm::mat4 gProjectionMatrix;
+glm::mat4 gViewMatrix;
+
+GLuint gPickedIndex = -1;
+std::string gMessage;
+
+GLuint programID;
+
+const GLuint NumObjects = 10;	// ATTN: THIS NEEDS TO CHANGE AS YOU ADD NEW OBJECTS
+GLuint VertexArrayId[NumObjects];
+GLuint VertexBufferId[NumObjects];
+GLuint IndexBufferId[NumObjects];
+
+// Shared mesh arena: the vertices and indices of every mesh live in one vertex and one index buffer
+// behind one VAO. A mesh's indices are relative to its MeshBaseVertex, so they stay 16-bit.
+GLuint MeshArenaVAO;
+GLuint MeshArenaVertexBuffer = 0;
+GLuint MeshArenaIndexBuffer = 0;
+size_t MeshArenaVertexBytes = 0, MeshArenaVertexCapacity = 0;
+size_t MeshArenaIndexBytes = 0, MeshArenaIndexCapacity = 0;
+// A reloaded mesh is written over its old range when it fits; otherwise the old range goes on a
+// free list that later meshes are placed in before the arena is extended
+struct ArenaRange {
+	size_t Offset;
+	size_t Bytes;
+};
+std::vector<ArenaRange> MeshArenaFreeVertices, MeshArenaFreeIndices;	// sorted by offset, adjacent ranges merged
+size_t MeshVertexRange[NumObjects];	// bytes of the arena owned by each mesh, 0 before it is first placed
+size_t MeshIndexRange[NumObjects];
+GLint MeshBaseVertex[NumObjects];
+GLuint MeshFirstIndex[NumObjects];
+
+// With ARB_multi_draw_indirect and ARB_base_instance every visible part goes out in one
+// glMultiDrawElementsIndirect; each command's base instance selects its ObjectBlock entry through
+// the per-instance DrawSlotIdBuffer (0, 1, 2, ...). Otherwise parts are drawn one by one with
+// glDrawElementsBaseVertex and the ObjectIndex uniform.
+struct DrawElementsIndirectCommand {
+	GLuint Count;
+	GLuint InstanceCount;
+	GLuint FirstIndex;
+	GLint BaseVertex;
+	GLuint BaseInstance;
+};
+bool UseMultiDrawIndirect = false;
+GLuint DrawSlotIdBuffer;
+GLuint DrawIndirectBuffer;
+
+// TL
+size_t VertexBufferSize[NumObjects];
+size_t IndexBufferSize[NumObjects];
+size_t NumIdcs[NumObjects];
+size_t NumVerts[NumObjects];
+
+GLuint MatrixID;
+GLuint ObjectIndexID;
+
+// Counts GL calls issued by renderScene(); shown in the GUI to check for redundant state changes
+#define GL_COUNTED(call) (gGLCallCount++, call)
+unsigned int gGLCallCount = 0;
+unsigned int gGLCallsPerFrame = 0;
+
+// Frame profiler: CPU stages are timed with profileBegin/profileEnd (or a ProfileScope), the scene
+// and GUI passes with GL_TIME_ELAPSED queries that are read one frame late so they never stall
+enum ProfileStage {
+	PROF_FRAME, PROF_INPUT, PROF_UPDATE, PROF_SUBMIT, PROF_GUI, PROF_SWAP, PROF_GPU_SCENE, PROF_GPU_GUI, PROF_STAGES
+};
+const char* ProfileStageName[PROF_STAGES] = { "frame", "input", "update", "submit", "gui", "swap", "gpu scene", "gpu gui" };
+enum { GPU_PASS_SCENE, GPU_PASS_GUI, GPU_PASSES };
+const int ProfileHistory = 240;	// samples kept per stage for the rolling statistics
+float ProfileSamples[PROF_STAGES][ProfileHistory];
+int ProfileSampleCount[PROF_STAGES];
+int ProfileSampleNext[PROF_STAGES];
+double ProfileStageMs[PROF_STAGES];	// accumulated over the current frame
+bool ProfileStageRan[PROF_STAGES];
+std::chrono::high_resolution_clock::time_point ProfileStart[PROF_STAGES];
+std::string ProfileSummary[PROF_STAGES];	// shown in the GUI
+double ProfileLastSummary = 0.0;
+int ProfileFrame = 0;
+GLuint GpuTimerQueries[2][GPU_PASSES];	// [frame parity][pass]
+bool GpuTimerPending[2][GPU_PASSES];
+double GpuTimerSubmitUs[2][GPU_PASSES];	// when the pass was issued, places it in the trace
+int GpuTimerActive = -1;
+const std::chrono::high_resolution_clock::time_point ProfileEpoch = std::chrono::high_resolution_clock::now();
+
+// Times the enclosing block as one CPU stage
+struct ProfileScope {
+	int Stage;
+	ProfileScope(int stage) : Stage(stage) { profileBegin(stage); }
+	~ProfileScope() { profileEnd(Stage); }
+};
+
+// Chrome trace ("about:tracing" / Perfetto) events, only recorded when a trace file was requested
+struct TraceEvent {
+	int Stage;
+	int Track;	// 1 CPU, 2 GPU
+	double StartUs;
+	double DurationUs;
+};
+const size_t MaxTraceEvents = 1 << 20;
+std::vector<TraceEvent> TraceEvents;
+const char* TracePath = NULL;
+
+// Camera and light, uploaded once per frame into the FrameBlock uniform block (std140)
+struct FrameUniforms {
+	glm::mat4 View;
+	glm::mat4 Projection;
+	glm::vec4 LightPosition;
+};
+
+// Per-draw model matrix, color and position dequantization, streamed into the ObjectBlock uniform block (std140)
+struct ObjectUniforms {
+	glm::mat4 Model;
+	glm::vec4 Color;
+	glm::vec4 PositionScale;
+	glm::vec4 PositionBias;
+};
+
+const int MaxDrawSlots = 128;	// must match the ObjectBlock array size in StandardShading.vertexshader
+const GLuint FrameBlockBinding = 0;
+const GLuint ObjectBlockBinding = 1;
+GLuint FrameUniformBufferId;
+GLuint ObjectUniformBufferId;
+FrameUniforms FrameData;
+FrameUniforms UploadedFrameData;
+ObjectUniforms DrawSlots[MaxDrawSlots];
+ObjectUniforms UploadedDrawSlots[MaxDrawSlots];
+int NumDrawSlots = 0;
+int NumUploadedDrawSlots = -1;	// -1 forces the first upload
+GLint CurrentObjectIndex = -1;	// uniform state cache for ObjectIndex
+
+// Render list: walking the scene emits one packet per draw, tagged with a 64-bit sort key. The
+// render thread sorts the packets and submits them, binding a program or vertex array only when the
+// next packet needs a different one. Preparation touches no GL state, so with --pipeline the scene
+// thread prepares frame N+1 while frame N's GUI is drawn and its buffers are swapped.
+enum PacketKind { PACKET_LINES, PACKET_MESH, PACKET_FLEET, PACKET_PROJECTILES };
+enum RenderPass { PASS_LINES, PASS_OPAQUE };	// lines first: they win depth ties with the meshes
+struct RenderPacket {
+	unsigned long long Key;	// pass (8 bits), program (16), vertex array (16), emission order (24)
+	int Kind;
+	GLuint Program;
+	GLuint VertexArray;
+	GLuint Count;	// vertices for lines, indices otherwise
+	GLuint First;	// first vertex for lines, first arena index otherwise
+	GLint BaseVertex;
+	GLuint Instances;
+	size_t InstanceOffset;	// fleet: byte offset of the part's matrices in FleetMatrixBuffer
+	int Slot;	// ObjectBlock entry
+};
+
+struct RenderList {
+	std::vector<RenderPacket> Packets;
+	FrameUniforms Frame;
+	ObjectUniforms Slots[MaxDrawSlots];
+	int NumSlots;
+	int Generation;	// SceneGeneration the packets were prepared against
+	bool Ready;	// prepared and not yet submitted
+	int PartsDrawn, PartsCulled, TrianglesDrawn, Projectiles;
+};
+
+RenderList SceneList;	// prepared, submitted, then prepared again for the next frame
+std::thread ScenePrepThread;
+bool PipelineScene = false;	// --pipeline
+int SceneGeneration = 0;	// bumped by input, mesh swaps and shader reloads; a list prepared earlier is rebuilt
+int ProjectilesDrawn = 0;	// last frame
+
+// Declare global objects
+// TL
+const size_t CoordVertsCount = 6;
+const size_t GridVertsCount = 44;
+Vertex CoordVerts[CoordVertsCount];
+Vertex GridVerts[GridVertsCount];
+
+// Mesh cache: each .obj is parsed and uploaded once, keyed by file path -> owning ObjectId
+std::map<std::string, int> MeshCache;
+
+// Per-object draw colors, streamed with the model matrices so that
+// changing the selection never touches vertex data
+glm::vec4 ObjectColor[NumObjects];
+glm::vec4 HighlightColor[NumObjects];
+char ObjectSelectKey[NumObjects];
+std::string ObjectName[NumObjects];	// mesh file, reported by picking
+
+// Model-space position = PositionBias + PositionScale * 16-bit position; identity for the float line vertices
+glm::vec4 PositionScale[NumObjects];
+glm::vec4 PositionBias[NumObjects];
+size_t MeshVertexCount = 0;	// unique mesh vertices uploaded, for the memory report
+
+// Model-space bounds of each mesh for frustum culling: box, and sphere as center + radius in w
+glm::vec3 MeshBoundsMin[NumObjects];
+glm::vec3 MeshBoundsMax[NumObjects];
+glm::vec4 MeshSphere[NumObjects];
+glm::vec4 FrustumPlanes[6];	// world space, normals point inside
+int PartsDrawn = 0;	// last frame
+int PartsCulled = 0;
+int TrianglesDrawn = 0;	// parts only, last frame
+
+// Bounding volume hierarchy over one mesh's triangles, kept on the CPU for picking.
+// Interior nodes store their children at First and First + 1.
+struct BVHNode {
+	glm::vec3 Min;
+	glm::vec3 Max;
+	int First;	// first triangle of a leaf, or left child of an interior node
+	int Count;	// triangles in a leaf, 0 for interior nodes
+};
+
+struct MeshBVH {
+	std::vector<glm::vec3> Positions;
+	std::vector<GLushort> Indices;	// three per triangle, reordered so every leaf is a contiguous range
+	std::vector<BVHNode> Nodes;
+};
+
+const int BVHLeafSize = 4;
+MeshBVH PickMeshes[NumObjects];
+int PickMeshSource[NumObjects];	// object owning the BVH; meshes shared through MeshCache point at the owner
+
+// Hot reload: a watcher thread notices saved shader and .obj files, reads shader sources and fully
+// prepares changed meshes (parse, weld, LODs, bounds, BVH). The render thread picks the results up
+// at the start of a frame without ever waiting on the watcher.
+struct PreparedMesh {
+	std::string File;
+	std::vector<PackedVertex> Vertices;	// empty when the mesh was staged in the ring
+	std::vector<GLushort> Indices;	// every level of detail
+	size_t NumVertices, NumIndices;
+	bool InRing;	// vertices, then indices, at RingOffset of StagingRingBuffer
+	size_t RingOffset;
+	MeshLods Lods;
+	glm::vec4 PositionScale, PositionBias;
+	glm::vec3 BoundsMin, BoundsMax;
+	glm::vec4 Sphere;
+	MeshBVH BVH;
+	std::vector<glm::vec3> Hull;
+};
+
+const char* VertexShaderPath = "StandardShading.vertexshader";
+const char* FragmentShaderPath = "StandardShading.fragmentshader";
+std::thread ReloadThread;
+std::atomic<bool> ReloadQuit(false);
+std::mutex ReloadMutex;	// guards the Ready* results below
+std::vector<PreparedMesh*> ReadyMeshes;
+std::string ReadyVertexSource, ReadyFragmentSource;
+bool ReadyShaders = false;
+LinearArena ReloadArena;	// scratch memory of the watcher thread
+GLuint PendingProgram = 0;	// compiled and linked, waiting for the driver to finish
+unsigned long long PendingProgramKey = 0;
+
+// Program binary cache. A linked program is saved with glGetProgramBinary and loaded with
+// glProgramBinary on the next start, as long as the entry's key still matches: a hash of both
+// shader sources and the driver's vendor, renderer and version strings. A driver may still reject
+// a binary, for instance after an update that kept its version string; the program is then
+// compiled from source and the entry rewritten.
+struct ProgramCacheHeader {
+	char Magic[4];	// "MVPB"
+	unsigned int Format;	// as returned by glGetProgramBinary
+	unsigned long long Key;
+	unsigned int Length;	// bytes of binary after the header
+	unsigned int Reserved;
+};
+
+const char* ProgramCachePath = "StandardShading.pbin";
+bool UseProgramCache = true;	// --no-shader-cache always compiles from source
+
+// Asset streaming: createObjects() only registers the parts and queues their files. Loader threads
+// decode each mesh straight into StagingRingBuffer, a persistently mapped ring, and hand it over
+// through ReadyMeshes like a reload. The render thread copies it into the mesh arena on the GPU and
+// fences the copy; the ring range is reused once the fence has signaled. A part is drawn as soon as
+// its mesh is resident. Without ARB_buffer_storage meshes are staged in client memory and uploaded
+// with glBufferSubData instead.
+struct StagingRange {
+	size_t Offset;	// where the data starts
+	size_t Bytes;	// including bytes skipped at the end of the ring to get there
+	bool Retired;
+};
+
+struct StagingFence {
+	GLsync Sync;
+	size_t Offset;	// range retired when Sync has signaled
+};
+
+const size_t StagingRingSize = 4 << 20;
+const size_t StagingAlignment = 64;
+GLuint StagingRingBuffer = 0;
+unsigned char* StagingRingData = NULL;	// mapped for the lifetime of the buffer; NULL without a ring
+std::mutex StagingRingMutex;	// guards the ranges, head and used bytes
+std::condition_variable StagingRingSpace;
+std::deque<StagingRange> StagingRanges;	// in flight, oldest first, contiguous up to StagingRingHead
+size_t StagingRingHead = 0;
+size_t StagingRingUsed = 0;
+std::deque<StagingFence> StagingFences;	// render thread only
+std::vector<std::string> StreamFiles;	// one per unique mesh, in createObjects() order
+std::atomic<int> NextStreamFile(0);
+std::atomic<int> MeshesPending(0);	// queued files not yet resident
+std::vector<std::thread> StreamThreads;
+std::atomic<bool> StreamQuit(false);
+const int MaxStreamThreads = 4;
+bool MeshResident[NumObjects];
+std::chrono::high_resolution_clock::time_point StreamStart;
+double FirstFrameMs = -1.0;	// since StreamStart
+
+// Closest part under a ray; T is in units of the ray direction
+struct PickHit {
+	int Node;
+	int ObjectId;
+	float T;
+	glm::vec3 Point;
+};
+
+// Vertex welding tolerance per component, same as the similarity test of the stock indexVBO
+float WeldEpsilon = 0.01f;
+
+// Level of detail: each level halves the triangles of the previous one, and simplification stops
+// once it would move the surface by more than LodMaxError of the mesh diagonal. A level is drawn
+// while its error projects to at most LodPixelError pixels; a coarser level than last frame's must
+// stay under LodPixelError * LodHysteresis, so parts near a threshold do not pop back and forth.
+MeshLods ObjectLods[NumObjects];
+int LodMinTriangles = 32;
+float LodMaxError = 0.25f;
+float LodBoundaryWeight = 10.0f;
+float LodPixelError = 1.0f;
+float LodHysteresis = 0.75f;
+glm::vec3 CameraPosition;
+
+char selection = 'C';
+bool shift_press = false;
+const float PI = 3.14159265;
+
+//transformation variables
+float trans_base_x = 0.0f;
+float trans_base_z = 0.0f;
+float rot_camera_side = PI/4;
+float rot_camera_up = PI/3;
+float rot_pen_long = 0.0f;
+float rot_pen_lat = 0.0f;
+float rot_pen_twist = 0.0f;
+float rot_arm2 = 0.0f;
+float rot_arm1 = 0.0f;
+float rot_top = 0.0f;
+
+// Joint values of the arm. Input edits the globals above; the simulation thread copies them
+// once per tick and the renderer draws the value interpolated between the last two ticks.
+struct JointState {
+	float trans_base_x, trans_base_z;
+	float rot_top, rot_arm1, rot_arm2;
+	float rot_pen_long, rot_pen_lat, rot_pen_twist;
+};
+
+// Inverse kinematics for pen-tip targets. Batches are structures of arrays: every iteration runs
+// the same straight-line math over IKBlock lanes at a time, and converged lanes just stop moving.
+// Solved for top, arm1, arm2, pen long and pen lat; the twist does not move the tip.
+struct IKBatch {
+	int Count;
+	std::vector<float> TargetX, TargetY, TargetZ;	// world space
+	std::vector<float> Top, Arm1, Arm2, PenLong, PenLat;	// seed on input, solution on output
+	std::vector<float> Error;	// distance left between tip and target
+	std::vector<int> Iterations;
+};
+
+const int IKBlock = 64;
+const int IKMaxIterations = 64;
+const float IKTolerance = 1e-4f;	// world units
+const float IKDamping = 0.05f;	// lambda of the damped least squares step
+const float IKMaxStep = 0.35f;	// radians, largest joint change per iteration
+const float Arm1Limit = 3 * PI / 4;	// same bound as the arrow keys
+
+// Offsets of the chain, as built by jointLocalMatrix() and createHierarchy()
+const float IKTopHeight = 1.6f;
+const float IKArm1Length = 2.0f;
+const float IKArm2Length = 1.8f;
+const float IKPenTip = 0.4f;	// NODE_SOLID below the pen origin
+
+// Trajectory playback: the waypoints of a --trajectory file are solved in order at startup, each
+// seeded with the previous solution, then the simulation thread poses the arm at one waypoint per tick
+IKBatch Trajectory;
+int TrajectoryStep = -1;	// next waypoint, -1 when not playing; guarded by SimInputMutex
+
+// Self collision. Every part is convex, so its hull is just its distinct vertex positions, and GJK
+// tests two hulls through their support points alone. Only non-adjacent parts that are apart in the
+// rest pose are checked, each pair first by bounding spheres. Moves that would make parts overlap
+// are cut back, by bisection, to the furthest pose without contact.
+struct CollisionPair {
+	int NodeA, NodeB;
+	glm::vec3 Separation;	// last separating direction in NodeA's frame, where the next GJK run starts
+};
+
+const int GJKMaxIterations = 32;
+const int ClampSteps = 10;	// bisection steps when cutting a move back
+std::vector<glm::vec3> CollisionHulls[NumObjects];	// model space, by PickMeshSource; guarded by SimInputMutex
+std::vector<CollisionPair> CollisionPairs;	// guarded by SimInputMutex, like everything below
+bool CollisionPairsValid = false;	// false until every part's hull is in, and after a reload
+JointState LastCheckedJoints;
+bool LastCheckedResult = false;
+bool HaveLastCheck = false;
+long long SphereRejects = 0;
+long long GJKRuns = 0;
+int MovesClamped = 0;
+
+// Projectile pool, structure of arrays so the integrator runs as straight vector loops.
+// Owned by the simulation thread; all live solids are drawn with one instanced draw of Solid.obj.
+const int MaxProjectiles = 65536;
+const int ProjectileBurst = 16;	// solids per S press
+const int ProjectileFirePerTick = 8;	// solids per simulation tick while S is held
+const float ProjectileSpeed = 4.0f;
+const float ProjectileLifetime = 20.0f;
+const float Gravity = 9.8f;
+std::vector<float> ProjPosX, ProjPosY, ProjPosZ;
+std::vector<float> ProjPrevX, ProjPrevY, ProjPrevZ;	// positions one tick earlier, for interpolation
+std::vector<float> ProjVelX, ProjVelY, ProjVelZ;
+std::vector<float> ProjLife;
+int NumProjectiles = 0;
+unsigned int ProjectileSeed = 0x9E3779B9u;
+std::vector<float> RenderProjX, RenderProjY, RenderProjZ;	// interpolated copy drawn by the render thread
+int NumRenderProjectiles = 0;
+GLuint ProjectileVAO;
+GLuint ProjectileBufferId;	// instance positions: all x, then all y, then all z
+
+// Fixed-timestep simulation thread. Each tick publishes a snapshot of joint and projectile
+// state; three slots let the simulation write one while the renderer reads the last two.
+struct SimSnapshot {
+	double Time;
+	JointState Joints;
+	int NumProjectiles;
+	std::vector<float> PrevX, PrevY, PrevZ;
+	std::vector<float> X, Y, Z;
+};
+
+const double SimTickRate = 120.0;
+std::thread SimThread;
+std::atomic<bool> SimRunning(false);
+double SimTime = 0.0;	// time of the last tick
+std::mutex SimInputMutex;	// guards the joint globals and the fire requests below
+int PendingSpawns = 0;
+bool FireHeld = false;
+std::mutex SnapshotMutex;
+SimSnapshot Snapshots[3];
+int LatestSnapshot = 0;
+int PreviousSnapshot = 0;
+bool HaveSnapshot = false;
+JointState RenderJoints;
+
+// Input commands. The GLFW callbacks only record what happened; the main loop applies the queue
+// once per frame, merging repeated arrow steps, and then renders exactly once.
+enum CommandType { CMD_SELECT, CMD_SHIFT, CMD_STEP, CMD_FIRE, CMD_PICK, CMD_HOLD_FIRE };
+struct InputCommand {
+	int Type;
+	int Arg;	// CMD_SELECT: selection char, CMD_SHIFT/CMD_HOLD_FIRE: pressed, CMD_STEP: arrow key
+};
+
+// Single producer (event callbacks), single consumer (main loop) ring; capacity is a power of two
+const unsigned CommandQueueSize = 256;
+InputCommand CommandQueue[CommandQueueSize];
+std::atomic<unsigned> CommandHead(0);	// next slot to read
+std::atomic<unsigned> CommandTail(0);	// next slot to write
+unsigned DroppedCommands = 0;
+
+// Record and replay. A recording holds the starting state, every applied input stamped with the
+// simulation tick that first sees it, and a checkpoint of the simulation every ReplayCheckpointTicks
+// ticks. Replays run the simulation on the main thread and apply the inputs at the same ticks, so
+// the session repeats exactly whatever the frame rate.
+struct ReplayState {
+	unsigned long long ProjectileHash;	// FNV-1a of the projectile positions
+	JointState Joints;
+	float CameraSide, CameraUp;
+	int NumProjectiles;
+	unsigned int ProjectileSeed;
+};
+
+struct RecordedInput {
+	unsigned int Tick;
+	int Type;
+	int Arg;
+};
+
+struct ReplayCheckpoint {
+	unsigned int Tick;	// taken at the end of this tick
+	ReplayState State;
+};
+
+// File layout: header, inputs, checkpoints, then the recorded frame times in ms as floats
+struct ReplayHeader {
+	char Magic[4];	// "MVRP"
+	unsigned int Version;
+	unsigned int Ticks;	// length of the session
+	unsigned int NumInputs;
+	unsigned int NumCheckpoints;
+	unsigned int NumFrames;
+	int Selection;
+	int ShiftPress;
+	ReplayState Start;
+};
+
+const unsigned ReplayVersion = 1;
+const unsigned ReplayCheckpointTicks = 120;
+const char* RecordPath = NULL;
+bool Replaying = false;
+bool ReplayMaxSpeed = false;	// frames advance HeadlessClock by one 60 Hz frame, without vsync
+unsigned SimTicks = 0;	// ticks run since startSimulation; guarded by SimInputMutex
+ReplayHeader ReplayStart;
+std::vector<RecordedInput> ReplayInputs;	// guarded by SimInputMutex while recording
+size_t NextReplayInput = 0;
+std::vector<ReplayCheckpoint> ReplayCheckpoints;	// only touched by the simulation
+size_t NextReplayCheckpoint = 0;
+unsigned ReplayMatches = 0;
+unsigned ReplayMismatches = 0;
+std::vector<double> RecordedFrameMs;
+
+// Transform hierarchy: flat arrays in parent-before-child order, so one forward pass updates
+// every world matrix. A node is only recomputed when it or one of its ancestors is dirty.
+std::vector<int> NodeParent;
+std::vector<int> NodeObject;	// ObjectId drawn with the node's world matrix, -1 for none
+std::vector<glm::mat4> NodeLocal;
+std::vector<glm::mat4> NodeWorld;
+std::vector<unsigned char> NodeDirty;
+std::vector<glm::vec3> NodeParams;	// joint values the local matrix was last built from
+std::vector<int> NodeLod;	// level of detail drawn last frame
+
+// Robot arm nodes, in the order createHierarchy() adds them
+enum {
+	NODE_ROOT, NODE_BASE, NODE_TOP, NODE_ARM1, NODE_JOINT, NODE_ARM2, NODE_PEN, NODE_BUTTON, NODE_SOLID
+};
+
+// Fleet of extra arms on a grid around the main one (--fleet N). Poses are per-arm arrays; each
+// frame a batched forward kinematics pass on FramePool poses the visible arms and writes
+// their part matrices grouped by part, so every part is one instanced draw across the fleet.
+struct ArmFleet {
+	int Count;
+	std::vector<float> BaseX, BaseZ;
+	std::vector<float> Top, Arm1, Arm2, PenLong, PenLat, PenTwist;
+	std::vector<float> Phase, Speed;	// each arm moves at its own pace
+};
+
+const int FleetParts = NODE_BUTTON - NODE_BASE + 1;	// base, top, arm1, joint, arm2, pen, button
+const int FleetChunk = 256;	// arms per worker job
+const float FleetSpacing = 6.0f;
+ArmFleet Fleet;
+double FleetTime;
+std::vector<int> FleetVisible;	// arms inside the view this frame
+std::vector<glm::mat4> FleetMatrices;	// FleetParts runs of one world matrix per visible arm
+int FleetArmsDrawn = 0;	// last frame
+GLuint FleetVAO;
+GLuint FleetMatrixBuffer;	// FleetMatrices, read as a per-instance mat4 at attribute 7
+
+int initWindow(void) {
+	// Initialise GLFW
+	if (!glfwInit()) {
+		fprintf(stderr, "Failed to initialize GLFW\n");
+		return -1;
+	}
+
+	glfwWindowHint(GLFW_SAMPLES, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	//glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);	// FOR MAC
+
+	// Open a window and create its OpenGL context
+	window = glfwCreateWindow(window_width, window_height, "Fohrman, Kyle (UFID 0514-1178)", NULL, NULL);
+	if (window == NULL) {
+		fprintf(stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version of the tutorials.\n");
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+
+	// Initialize GLEW
+	glewExperimental = true; // Needed for core profile
+	if (glewInit() != GLEW_OK) {
+		fprintf(stderr, "Failed to initialize GLEW\n");
+		return -1;
+	}
+
+	// Initialize the GUI
+	TwInit(TW_OPENGL_CORE, NULL);
+	TwWindowSize(window_width, window_height);
+	TwBar * GUI = TwNewBar("Picking");
+	TwSetParam(GUI, NULL, "refresh", TW_PARAM_CSTRING, 1, "0.1");
+	TwAddVarRW(GUI, "Last picked object", TW_TYPE_STDSTRING, &gMessage, NULL);
+	TwAddVarRO(GUI, "GL calls/frame", TW_TYPE_UINT32, &gGLCallsPerFrame, NULL);
+	TwAddVarRO(GUI, "Projectiles", TW_TYPE_INT32, &ProjectilesDrawn, NULL);
+	TwAddVarRO(GUI, "Parts drawn", TW_TYPE_INT32, &PartsDrawn, NULL);
+	TwAddVarRO(GUI, "Parts culled", TW_TYPE_INT32, &PartsCulled, NULL);
+	TwAddVarRO(GUI, "Triangles drawn", TW_TYPE_INT32, &TrianglesDrawn, NULL);
+	TwAddVarRW(GUI, "LOD pixel error", TW_TYPE_FLOAT, &LodPixelError, "min=0 max=64 step=0.25");
+	// p50 / p95 / max over the last frames, then the histogram
+	for (int stage = 0; stage < PROF_STAGES; stage++)
+		TwAddVarRO(GUI, ProfileStageName[stage], TW_TYPE_STDSTRING, &ProfileSummary[stage], "group=Profiler");
+
+	// Set up inputs
+	glfwSetCursorPos(window, window_width / 2, window_height / 2);
+	glfwSetKeyCallback(window, keyCallback);
+	glfwSetMouseButtonCallback(window, mouseCallback);
+
+	return 0;
+}
+
+//-- PROFILER --//
+
+void initProfiler(void) {
+	glGenQueries(2 * GPU_PASSES, &GpuTimerQueries[0][0]);
+	if (TracePath != NULL)
+		TraceEvents.reserve(65536);
+}
+
+static double profileMicroseconds(std::chrono::high_resolution_clock::time_point t) {
+	return std::chrono::duration<double, std::micro>(t - ProfileEpoch).count();
+}
+
+static void recordTraceEvent(int stage, int track, double startUs, double durationUs) {
+	if (TracePath == NULL || TraceEvents.size() >= MaxTraceEvents)
+		return;
+	TraceEvent event = { stage, track, startUs, durationUs };
+	TraceEvents.push_back(event);
+}
+
+static void recordProfileSample(int stage, double ms) {
+	ProfileSamples[stage][ProfileSampleNext[stage]] = (float)ms;
+	ProfileSampleNext[stage] = (ProfileSampleNext[stage] + 1) % ProfileHistory;
+	ProfileSampleCount[stage] = std::min(ProfileSampleCount[stage] + 1, ProfileHistory);
+}
+
+void profileBegin(int stage) {
+	ProfileStart[stage] = std::chrono::high_resolution_clock::now();
+}
+
+void profileEnd(int stage) {
+	std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+	double us = std::chrono::duration<double, std::micro>(end - ProfileStart[stage]).count();
+	ProfileStageMs[stage] += us / 1000.0;
+	ProfileStageRan[stage] = true;
+	recordTraceEvent(stage, 1, profileMicroseconds(ProfileStart[stage]), us);
+}
+
+// GL_TIME_ELAPSED queries cannot nest, so only one pass is timed at a time
+void gpuTimerBegin(int pass) {
+	int slot = ProfileFrame & 1;
+	glBeginQuery(GL_TIME_ELAPSED, GpuTimerQueries[slot][pass]);
+	GpuTimerSubmitUs[slot][pass] = profileMicroseconds(std::chrono::high_resolution_clock::now());
+	GpuTimerActive = pass;
+}
+
+void gpuTimerEnd(void) {
+	glEndQuery(GL_TIME_ELAPSED);
+	GpuTimerPending[ProfileFrame & 1][GpuTimerActive] = true;
+	GpuTimerActive = -1;
+}
+
+// "p50 / p95 / max" over the history, then a histogram with one character per bucket, bucket k
+// holding samples under 2^(k-4) ms; each digit is that bucket's share of samples in tenths
+static void updateProfileSummary(int stage) {
+	int n = ProfileSampleCount[stage];
+	if (n == 0)
+		return;
+	float sorted[ProfileHistory];
+	memcpy(sorted, ProfileSamples[stage], sizeof(float) * n);
+	std::sort(sorted, sorted + n);
+	int buckets[10] = { 0 };
+	for (int i = 0; i < n; i++) {
+		int k = 0;
+		while (k < 9 && sorted[i] >= ldexpf(1.0f, k - 4))
+			k++;
+		buckets[k]++;
+	}
+	char text[128];
+	int len = snprintf(text, sizeof(text), "%.3f / %.3f / %.3f ms  ", sorted[(n - 1) / 2], sorted[(n - 1) * 95 / 100], sorted[n - 1]);
+	for (int k = 0; k < 10 && len < (int)sizeof(text) - 1; k++)
+		text[len++] = buckets[k] == 0 ? '.' : (char)('0' + std::min(9, buckets[k] * 10 / n));
+	text[len] = '\0';
+	ProfileSummary[stage] = text;
+}
+
+// Closes the frame: stores the CPU stage totals and collects whatever GPU results from the
+// previous frame are ready. Results that are not ready yet are dropped instead of waited for.
+void profileFrameEnd(void) {
+	int previous = (ProfileFrame + 1) & 1;
+	for (int pass = 0; pass < GPU_PASSES; pass++) {
+		if (!GpuTimerPending[previous][pass])
+			continue;
+		GpuTimerPending[previous][pass] = false;
+		// The first frame's passes include one-time driver work and some drivers report nonsense for it
+		if (ProfileFrame < 2)
+			continue;
+		GLint available = 0;
+		glGetQueryObjectiv(GpuTimerQueries[previous][pass], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(GpuTimerQueries[previous][pass], GL_QUERY_RESULT, &ns);
+		int stage = pass == GPU_PASS_SCENE ? PROF_GPU_SCENE : PROF_GPU_GUI;
+		recordProfileSample(stage, ns / 1e6);
+		recordTraceEvent(stage, 2, GpuTimerSubmitUs[previous][pass], ns / 1e3);
+	}
+	for (int stage = 0; stage < PROF_GPU_SCENE; stage++) {
+		if (ProfileStageRan[stage])
+			recordProfileSample(stage, ProfileStageMs[stage]);
+		ProfileStageMs[stage] = 0.0;
+		ProfileStageRan[stage] = false;
+	}
+	ProfileFrame++;
+
+	// Formatting is cheap but the GUI only refreshes every 0.1 s anyway
+	double now = profileMicroseconds(std::chrono::high_resolution_clock::now()) / 1e6;
+	if (now - ProfileLastSummary >= 0.25) {
+		ProfileLastSummary = now;
+		for (int stage = 0; stage < PROF_STAGES; stage++)
+			updateProfileSummary(stage);
+	}
+}
+
+// Writes the recorded events in the Chrome trace event format. GPU passes are drawn on their own
+// track starting where the CPU issued them, since elapsed-time queries carry no GPU timestamp.
+bool writeTrace(const char* path) {
+	FILE* out = fopen(path, "w");
+	if (out == NULL) {
+		fprintf(stderr, "Cannot write %s\n", path);
+		return false;
+	}
+	fprintf(out, "{\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+	for (size_t i = 0; i < TraceEvents.size(); i++) {
+		const TraceEvent &event = TraceEvents[i];
+		fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+			ProfileStageName[event.Stage], event.Track, event.StartUs, event.DurationUs);
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+	printf("Wrote %d trace events to %s\n", (int)TraceEvents.size(), path);
+	return true;
+}
+
+//-- HEADLESS --//
+
+// Creates a GL 3.3 core context without any window and binds an offscreen framebuffer
+// the size of the window, so the rest of the renderer runs unchanged
+int initHeadless(void) {
+#ifdef HEADLESS_EGL
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay != NULL)
+		HeadlessDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (HeadlessDisplay == EGL_NO_DISPLAY)
+		HeadlessDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (HeadlessDisplay == EGL_NO_DISPLAY || !eglInitialize(HeadlessDisplay, NULL, NULL)) {
+		fprintf(stderr, "Failed to initialize EGL\n");
+		return -1;
+	}
+	eglBindAPI(EGL_OPENGL_API);
+
+	// Nothing is ever presented, so any config will do; fall back to none at all
+	const EGLint configAttribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(HeadlessDisplay, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+		config = EGL_NO_CONFIG_KHR;
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	HeadlessContext = eglCreateContext(HeadlessDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+	if (HeadlessContext == EGL_NO_CONTEXT || !eglMakeCurrent(HeadlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, HeadlessContext)) {
+		fprintf(stderr, "Failed to create a surfaceless OpenGL 3.3 context\n");
+		eglTerminate(HeadlessDisplay);
+		return -1;
+	}
+
+	// Initialize GLEW; a GLX build of GLEW only fails to find its (unneeded) GLX display here
+	glewExperimental = true; // Needed for core profile
+	GLenum glewError = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	if (glewError == GLEW_ERROR_NO_GLX_DISPLAY)
+		glewError = GLEW_OK;
+#endif
+	if (glewError != GLEW_OK) {
+		fprintf(stderr, "Failed to initialize GLEW\n");
+		shutdownHeadless();
+		return -1;
+	}
+
+	glGenFramebuffers(1, &HeadlessFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, HeadlessFramebuffer);
+	glGenRenderbuffers(2, HeadlessRenderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, HeadlessRenderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, window_width, window_height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, HeadlessRenderbuffers[0]);
+	glBindRenderbuffer(GL_RENDERBUFFER, HeadlessRenderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, HeadlessRenderbuffers[1]);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "Offscreen framebuffer is incomplete\n");
+		shutdownHeadless();
+		return -1;
+	}
+	glViewport(0, 0, window_width, window_height);
+	printf("Headless: %s, OpenGL %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+	return 0;
+#else
+	fprintf(stderr, "Headless mode needs a build with -DHEADLESS_EGL (and libEGL)\n");
+	return -1;
+#endif
+}
+
+void shutdownHeadless(void) {
+#ifdef HEADLESS_EGL
+	if (HeadlessFramebuffer != 0) {
+		glDeleteFramebuffers(1, &HeadlessFramebuffer);
+		glDeleteRenderbuffers(2, HeadlessRenderbuffers);
+	}
+	eglMakeCurrent(HeadlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (HeadlessContext != EGL_NO_CONTEXT)
+		eglDestroyContext(HeadlessDisplay, HeadlessContext);
+	eglTerminate(HeadlessDisplay);
+#endif
+}
+
+// Clock for simulation and interpolation: wall time normally, frame time when headless or
+// replaying at maximum speed
+double viewerTime(void) {
+	return (Headless || ReplayMaxSpeed) ? HeadlessClock : glfwGetTime();
+}
+
+// Pose and camera of the benchmark sequence at time t: orbit the camera, sweep every joint
+// inside its key limits, and fire a burst twice a second with a stream in between
+static void headlessScript(int frame, double t) {
+	std::lock_guard<std::mutex> lock(SimInputMutex);
+	rot_camera_side = (float)(PI / 4 + 0.5 * t);
+	rot_camera_up = (float)(PI / 3 + 0.3 * sin(0.7 * t));
+	trans_base_x = (float)(0.5 * sin(0.6 * t));
+	trans_base_z = (float)(0.5 * cos(0.4 * t));
+	rot_top = (float)(0.8 * t);
+	rot_arm1 = (float)(0.6 * sin(1.3 * t));
+	rot_arm2 = (float)(0.8 * sin(0.9 * t));
+	rot_pen_long = (float)(0.5 * sin(2.0 * t));
+	rot_pen_lat = (float)(0.4 * cos(1.7 * t));
+	rot_pen_twist = (float)t;
+	if (frame % 30 == 0)
+		PendingSpawns += ProjectileBurst;
+	FireHeld = (frame / 120) % 2 == 1;
+}
+
+// Script, reloads and simulation for the given frame
+static void stepHeadless(int frame) {
+	HeadlessClock = frame / HeadlessFrameRate;
+	headlessScript(frame, HeadlessClock);
+	applyReloads();
+	advanceSimulation(HeadlessClock);
+}
+
+static void writeFramePPM(const char* path, const unsigned char* rgba) {
+	FILE* out = fopen(path, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "Cannot write %s\n", path);
+		return;
+	}
+	fprintf(out, "P6\n%d %d\n255\n", window_width, window_height);
+	std::vector<unsigned char> row(window_width * 3);
+	for (int y = window_height - 1; y >= 0; y--) {	// GL rows start at the bottom
+		const unsigned char* src = rgba + (size_t)y * window_width * 4;
+		for (int x = 0; x < window_width; x++) {
+			row[3 * x] = src[4 * x];
+			row[3 * x + 1] = src[4 * x + 1];
+			row[3 * x + 2] = src[4 * x + 2];
+		}
+		fwrite(&row[0], 1, row.size(), out);
+	}
+	fclose(out);
+}
+
+// Prints the mean and percentiles of a run's frame times
+void printFrameTimes(std::vector<double> frameMs) {
+	std::sort(frameMs.begin(), frameMs.end());
+	double total = 0.0;
+	for (size_t i = 0; i < frameMs.size(); i++)
+		total += frameMs[i];
+	if (!frameMs.empty()) {
+		size_t n = frameMs.size();
+		printf("%d frames: mean %.3f ms  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n", (int)n, total / n,
+			frameMs[(n - 1) * 50 / 100], frameMs[(n - 1) * 90 / 100], frameMs[(n - 1) * 99 / 100], frameMs[n - 1]);
+	}
+}
+
+// Renders the scripted sequence for frames frames and prints frame time percentiles. Frames are
+// timed up to glFinish. With checksums, prints an FNV-1a hash of every frame and of the whole run;
+// with dumpPrefix, writes each frame to <dumpPrefix>NNNN.ppm.
+int runHeadless(int frames, const char* dumpPrefix, bool checksums) {
+	Headless = true;
+	if (initHeadless() != 0)
+		return 1;
+	initOpenGL();
+	// Checksums must not depend on how many parts happened to be loaded by a given frame
+	if (checksums)
+		finishStreaming();
+	startSimulation();
+
+	std::vector<double> frameMs;
+	std::vector<unsigned char> pixels;
+	if (checksums || dumpPrefix != NULL)
+		pixels.resize((size_t)window_width * window_height * 4);
+	unsigned long long runHash = 14695981039346656037ULL;
+	long long totalDrawn = 0, totalCulled = 0, totalTriangles = 0, totalFleet = 0;
+	for (int frame = 0; frame < frames; frame++) {
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		profileBegin(PROF_FRAME);
+		// Pipelined runs step the next frame's script and simulation before waiting for this one, so
+		// its list is prepared while the GPU finishes and every frame still shows the same state
+		if (!PipelineScene || frame == 0)
+			stepHeadless(frame);
+		renderScene();
+		totalDrawn += PartsDrawn;
+		totalCulled += PartsCulled;
+		totalTriangles += TrianglesDrawn;
+		totalFleet += FleetArmsDrawn;
+		if (PipelineScene && frame + 1 < frames) {
+			stepHeadless(frame + 1);
+			prepareNextFrame(HeadlessClock);
+		}
+		glFinish();
+		profileEnd(PROF_FRAME);
+		frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+		profileFrameEnd();
+
+		if (pixels.empty())
+			continue;
+		glReadPixels(0, 0, window_width, window_height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+		if (checksums) {
+			unsigned long long hash = fnv1a(&pixels[0], pixels.size(), 14695981039346656037ULL);
+			runHash = fnv1a(&hash, sizeof(hash), runHash);
+			printf("frame %4d checksum %016llx\n", frame, hash);
+		}
+		if (dumpPrefix != NULL) {
+			char path[1024];
+			snprintf(path, sizeof(path), "%s%04d.ppm", dumpPrefix, frame);
+			writeFramePPM(path, &pixels[0]);
+		}
+	}
+	waitRenderList();
+	stopSimulation();
+	stopStreaming();
+
+	printFrameTimes(frameMs);
+	printf("parts drawn %lld, culled %lld, %lld triangles\n", totalDrawn, totalCulled, totalTriangles);
+	if (Fleet.Count > 0 && frames > 0)
+		printf("fleet of %d arms: %.1f drawn per frame in %d instanced draws\n", Fleet.Count, (double)totalFleet / frames, FleetParts);
+	if (checksums)
+		printf("run checksum %016llx\n", runHash);
+	cleanup();
+	stopWorkers();
+	return 0;
+}
+
+// Uniform locations and block bindings of a freshly linked StandardShading program
+void setupProgram(GLuint program) {
+	// Get a handle for our "MVP" uniform
+	MatrixID = glGetUniformLocation(program, "MVP");
+	// Get a handle for our "ObjectIndex" uniform, which picks the draw's entry in ObjectBlock
+	// (added to the per-instance drawSlot of indirect draws, which is 0 otherwise)
+	ObjectIndexID = glGetUniformLocation(program, "ObjectIndex");
+	// Camera/light and per-draw data live in uniform buffers instead of per-draw uniforms
+	glUniformBlockBinding(program, glGetUniformBlockIndex(program, "FrameBlock"), FrameBlockBinding);
+	glUniformBlockBinding(program, glGetUniformBlockIndex(program, "ObjectBlock"), ObjectBlockBinding);
+}
+
+void initOpenGL(void) {
+	// Enable depth test
+	glEnable(GL_DEPTH_TEST);
+	// Accept fragment if it closer to the camera than the former one
+	glDepthFunc(GL_LESS);
+	// Cull triangles which normal is not towards the camera
+	glEnable(GL_CULL_FACE);
+
+	// Projection matrix : 45 Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
+	gProjectionMatrix = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+	// Or, for an ortho camera :
+	//gProjectionMatrix = glm::ortho(-4.0f, 4.0f, -3.0f, 3.0f, 0.0f, 100.0f); // In world coordinates
+
+	// Camera matrix
+	gViewMatrix = glm::lookAt(glm::vec3(10.0, 10.0, 10.0f),	// eye
+		glm::vec3(0.0, 0.0, 0.0),	// center
+		glm::vec3(0.0, 1.0, 0.0));	// up
+
+	// Create and compile our GLSL program from the shaders
+	programID = loadProgram();
+	setupProgram(programID);
+	glVertexAttribI4i(6, 0, 0, 0, 0);
+	// Draws without the fleet's instance matrices see identity
+	for (int k = 0; k < 4; k++)
+		glVertexAttrib4f(7 + k, k == 0, k == 1, k == 2, k == 3);
+
+	// Camera/light and per-draw data live in uniform buffers instead of per-draw uniforms
+	glGenBuffers(1, &FrameUniformBufferId);
+	glBindBuffer(GL_UNIFORM_BUFFER, FrameUniformBufferId);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FrameBlockBinding, FrameUniformBufferId);
+	glGenBuffers(1, &ObjectUniformBufferId);
+	glBindBuffer(GL_UNIFORM_BUFFER, ObjectUniformBufferId);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(DrawSlots), NULL, GL_STREAM_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, ObjectBlockBinding, ObjectUniformBufferId);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	initProfiler();
+
+	// TL
+	// Define objects
+	UseMultiDrawIndirect = GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance;
+	printf("Static parts drawn with %s\n", UseMultiDrawIndirect ? "one glMultiDrawElementsIndirect" : "glDrawElementsBaseVertex per part");
+	createMeshArena();
+	StreamStart = std::chrono::high_resolution_clock::now();
+	createStagingRing();
+	createObjects();
+	startStreaming();
+	createHierarchy();
+	createProjectiles();
+	if (Fleet.Count > 0)
+		createFleetVAO();
+
+	// ATTN: create VAOs for each of the newly created objects here:
+	VertexBufferSize[0] = sizeof(CoordVerts);
+	VertexBufferSize[1] = sizeof(GridVerts);
+	NumVerts[0] = CoordVertsCount;
+	NumVerts[1] = GridVertsCount;
+
+	createVAOs(CoordVerts, NULL, 0);
+	createVAOs(GridVerts, NULL, 1);
+	PositionScale[0] = PositionScale[1] = glm::vec4(1.0, 1.0, 1.0, 0.0);
+	PositionBias[0] = PositionBias[1] = glm::vec4(0.0);
+}
+
+void createVAOs(Vertex Vertices[], unsigned short Indices[], int ObjectId) {
+	GLenum ErrorCheckValue = glGetError();
+	const size_t VertexSize = sizeof(Vertices[0]);
+	const size_t RgbOffset = sizeof(Vertices[0].Position);
+	const size_t Normaloffset = sizeof(Vertices[0].Color) + RgbOffset;
+
+	// Create Vertex Array Object
+	glGenVertexArrays(1, &VertexArrayId[ObjectId]);
+	glBindVertexArray(VertexArrayId[ObjectId]);
+
+	// Create Buffer for vertex data
+	glGenBuffers(1, &VertexBufferId[ObjectId]);
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBufferId[ObjectId]);
+	glBufferData(GL_ARRAY_BUFFER, VertexBufferSize[ObjectId], Vertices, GL_STATIC_DRAW);
+
+	// Create Buffer for indices
+	if (Indices != NULL) {
+		glGenBuffers(1, &IndexBufferId[ObjectId]);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBufferId[ObjectId]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndexBufferSize[ObjectId], Indices, GL_STATIC_DRAW);
+	}
+
+	// Assign vertex attributes
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, VertexSize, 0);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, VertexSize, (GLvoid*)RgbOffset);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VertexSize, (GLvoid*)Normaloffset);	// TL
+
+	glEnableVertexAttribArray(0);	// position
+	glEnableVertexAttribArray(1);	// color
+	glEnableVertexAttribArray(2);	// normal
+
+	// Disable our Vertex Buffer Object 
+	glBindVertexArray(0);
+
+	ErrorCheckValue = glGetError();
+	if (ErrorCheckValue != GL_NO_ERROR)
+	{
+		fprintf(
+			stderr,
+			"ERROR: Could not create a VBO: %s \n",
+			gluErrorString(ErrorCheckValue)
+		);
+	}
+}
+
+// Attribute layout of PackedVertex in the bound GL_ARRAY_BUFFER. Attribute 1 (color) stays
+// disabled and reads the generic value set before the mesh draws.
+void setPackedVertexAttribs(void) {
+	// Integer positions are read unnormalized (0..65535); PositionScale already includes the 1/65535
+	glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(PackedVertex), (GLvoid*)offsetof(PackedVertex, Position));
+	glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (GLvoid*)offsetof(PackedVertex, Normal));
+	glEnableVertexAttribArray(0);	// position
+	glEnableVertexAttribArray(2);	// normal
+}
+
+// Reallocates buffer with room for capacity bytes, keeping its first used bytes
+static void growMeshArenaBuffer(GLuint &buffer, size_t used, size_t capacity) {
+	GLuint grown;
+	glGenBuffers(1, &grown);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, GL_STATIC_DRAW);
+	if (used > 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+	}
+	glDeleteBuffers(1, &buffer);
+	buffer = grown;
+}
+
+// Points vao's mesh attributes and element buffer at the arena; repeated whenever the arena grows
+void attachMeshArena(GLuint vao) {
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, MeshArenaVertexBuffer);
+	setPackedVertexAttribs();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, MeshArenaIndexBuffer);
+	glBindVertexArray(0);
+}
+
+void createMeshArena(void) {
+	glGenVertexArrays(1, &MeshArenaVAO);
+	glBindVertexArray(MeshArenaVAO);
+	GLint slotIds[MaxDrawSlots];
+	for (int i = 0; i < MaxDrawSlots; i++)
+		slotIds[i] = i;
+	glGenBuffers(1, &DrawSlotIdBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, DrawSlotIdBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(slotIds), slotIds, GL_STATIC_DRAW);
+	glVertexAttribIPointer(6, 1, GL_INT, sizeof(GLint), (GLvoid*)0);
+	glVertexAttribDivisor(6, 1);
+	if (UseMultiDrawIndirect)
+		glEnableVertexAttribArray(6);
+	glBindVertexArray(0);
+
+	if (UseMultiDrawIndirect) {
+		glGenBuffers(1, &DrawIndirectBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, DrawIndirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * MaxDrawSlots, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+// Returns a range to the free list, merging it with its neighbours
+static void releaseArenaRange(std::vector<ArenaRange> &ranges, size_t offset, size_t bytes) {
+	ArenaRange range = { offset, bytes };
+	std::vector<ArenaRange>::iterator it = std::lower_bound(ranges.begin(), ranges.end(), range,
+		[](const ArenaRange &a, const ArenaRange &b) { return a.Offset < b.Offset; });
+	it = ranges.insert(it, range);
+	if (it + 1 != ranges.end() && it->Offset + it->Bytes == (it + 1)->Offset) {
+		it->Bytes += (it + 1)->Bytes;
+		ranges.erase(it + 1);
+	}
+	if (it != ranges.begin() && (it - 1)->Offset + (it - 1)->Bytes == it->Offset) {
+		(it - 1)->Bytes += it->Bytes;
+		ranges.erase(it);
+	}
+}
+
+// First fit from the free list; the rest of a larger range stays free
+static bool takeArenaRange(std::vector<ArenaRange> &ranges, size_t bytes, size_t &offset) {
+	for (size_t i = 0; i < ranges.size(); i++) {
+		if (ranges[i].Bytes < bytes)
+			continue;
+		offset = ranges[i].Offset;
+		ranges[i].Offset += bytes;
+		ranges[i].Bytes -= bytes;
+		if (ranges[i].Bytes == 0)
+			ranges.erase(ranges.begin() + i);
+		return true;
+	}
+	return false;
+}
+
+// Finds room for bytes in one arena buffer: the mesh's own range, then a free range, then the end
+// (growing the buffer when full). Returns true if the buffer was reallocated.
+static bool placeArenaRange(GLuint &buffer, size_t &used, size_t &capacity, size_t minCapacity, std::vector<ArenaRange> &ranges,
+	size_t &owned, size_t ownedOffset, size_t bytes, size_t &offset) {
+	if (owned >= bytes) {
+		offset = ownedOffset;
+		return false;
+	}
+	if (owned > 0)
+		releaseArenaRange(ranges, ownedOffset, owned);
+	owned = bytes;
+	if (takeArenaRange(ranges, bytes, offset))
+		return false;
+	bool grown = false;
+	if (used + bytes > capacity) {
+		size_t grownCapacity = std::max(std::max(capacity * 2, minCapacity), used + bytes);
+		growMeshArenaBuffer(buffer, used, grownCapacity);
+		capacity = grownCapacity;
+		grown = true;
+	}
+	offset = used;
+	used += bytes;
+	return grown;
+}
+
+// Makes room for ObjectId's vertices and indices in the arena and returns their byte offsets. A
+// reload reuses the mesh's old range when the new data fits.
+static void reserveMeshArena(int ObjectId, size_t &vertOffset, size_t &idxOffset) {
+	size_t vertBytes = VertexBufferSize[ObjectId], idxBytes = IndexBufferSize[ObjectId];
+	bool grown = placeArenaRange(MeshArenaVertexBuffer, MeshArenaVertexBytes, MeshArenaVertexCapacity, (size_t)4096 * sizeof(PackedVertex),
+		MeshArenaFreeVertices, MeshVertexRange[ObjectId], sizeof(PackedVertex) * MeshBaseVertex[ObjectId], vertBytes, vertOffset);
+	if (placeArenaRange(MeshArenaIndexBuffer, MeshArenaIndexBytes, MeshArenaIndexCapacity, (size_t)16384 * sizeof(GLushort),
+		MeshArenaFreeIndices, MeshIndexRange[ObjectId], sizeof(GLushort) * MeshFirstIndex[ObjectId], idxBytes, idxOffset))
+		grown = true;
+	if (grown) {
+		attachMeshArena(MeshArenaVAO);
+		if (ProjectileVAO != 0)
+			attachMeshArena(ProjectileVAO);
+		if (FleetVAO != 0)
+			attachMeshArena(FleetVAO);
+	}
+
+	MeshBaseVertex[ObjectId] = (GLint)(vertOffset / sizeof(PackedVertex));
+	MeshFirstIndex[ObjectId] = (GLuint)(idxOffset / sizeof(GLushort));
+	MeshVertexCount += vertBytes / sizeof(PackedVertex);
+}
+
+// Copies ObjectId's vertices and indices from client memory into the arena
+void appendMeshArena(const PackedVertex* Vertices, const GLushort* Indices, int ObjectId) {
+	size_t vertOffset, idxOffset;
+	reserveMeshArena(ObjectId, vertOffset, idxOffset);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, MeshArenaVertexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, vertOffset, VertexBufferSize[ObjectId], Vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, MeshArenaIndexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, idxOffset, IndexBufferSize[ObjectId], Indices);
+
+	GLenum ErrorCheckValue = glGetError();
+	if (ErrorCheckValue != GL_NO_ERROR)
+		fprintf(stderr, "ERROR: Could not create a VBO: %s \n", gluErrorString(ErrorCheckValue));
+}
+
+// Same for a mesh staged at ringOffset of the staging ring, vertices then indices. The copy stays
+// on the GPU; the fence tells when the ring range may be written again.
+void copyMeshArena(size_t ringOffset, int ObjectId) {
+	size_t vertOffset, idxOffset;
+	reserveMeshArena(ObjectId, vertOffset, idxOffset);
+	glBindBuffer(GL_COPY_READ_BUFFER, StagingRingBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, MeshArenaVertexBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, ringOffset, vertOffset, VertexBufferSize[ObjectId]);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, MeshArenaIndexBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, ringOffset + VertexBufferSize[ObjectId], idxOffset, IndexBufferSize[ObjectId]);
+	StagingFence fence = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), ringOffset };
+	StagingFences.push_back(fence);
+
+	GLenum ErrorCheckValue = glGetError();
+	if (ErrorCheckValue != GL_NO_ERROR)
+		fprintf(stderr, "ERROR: Could not copy a staged mesh: %s \n", gluErrorString(ErrorCheckValue));
+}
+
+// Quantizes positions to 16 bits over their bounds and normals to 2_10_10_10; returns the bounds
+void packVertices(const StagingVector<glm::vec3> &positions, const StagingVector<glm::vec3> &normals, PackedVertex* out, glm::vec3 &lo, glm::vec3 &hi) {
+	lo = hi = positions.empty() ? glm::vec3(0.0f) : positions[0];
+	for (size_t i = 1; i < positions.size(); i++) {
+		lo = glm::vec3(std::min(lo.x, positions[i].x), std::min(lo.y, positions[i].y), std::min(lo.z, positions[i].z));
+		hi = glm::vec3(std::max(hi.x, positions[i].x), std::max(hi.y, positions[i].y), std::max(hi.z, positions[i].z));
+	}
+	for (size_t i = 0; i < positions.size(); i++) {
+		for (int k = 0; k < 3; k++) {
+			float extent = hi[k] - lo[k];
+			float unit = extent > 0.0f ? (positions[i][k] - lo[k]) / extent : 0.0f;
+			out[i].Position[k] = (GLushort)(unit * 65535.0f + 0.5f);
+		}
+		out[i].Position[3] = 0;
+		GLuint packed = 0;
+		for (int k = 0; k < 3; k++) {
+			float n = std::max(-1.0f, std::min(1.0f, normals[i][k]));
+			int q = (int)lrintf(n * 511.0f);
+			packed |= ((GLuint)q & 0x3FF) << (10 * k);
+		}
+		out[i].Normal = packed;
+	}
+}
+
+// Dequantization of ObjectId's positions from the bounds they were packed against
+void setMeshBounds(int ObjectId, const glm::vec3 &lo, const glm::vec3 &hi) {
+	PositionScale[ObjectId] = glm::vec4((hi - lo) / 65535.0f, 0.0f);
+	PositionBias[ObjectId] = glm::vec4(lo, 0.0f);
+}
+
+// Same dequantization as the vertex shader
+glm::vec3 unpackPosition(const PackedVertex &vertex, const glm::vec4 &scale, const glm::vec4 &bias) {
+	return glm::vec3(bias.x + scale.x * vertex.Position[0], bias.y + scale.y * vertex.Position[1], bias.z + scale.z * vertex.Position[2]);
+}
+
+//-- CULLING --//
+
+// Box from the dequantized vertices; the sphere is centered on the box and just encloses every vertex
+void measureMesh(const PackedVertex* verts, size_t vertCount, const glm::vec4 &scale, const glm::vec4 &bias, glm::vec3 &lo, glm::vec3 &hi, glm::vec4 &sphere) {
+	lo = hi = glm::vec3(0.0f);
+	for (size_t i = 0; i < vertCount; i++) {
+		glm::vec3 p = unpackPosition(verts[i], scale, bias);
+		lo = i == 0 ? p : glm::vec3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+		hi = i == 0 ? p : glm::vec3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+	}
+	glm::vec3 center = (lo + hi) * 0.5f;
+	float radius2 = 0.0f;
+	for (size_t i = 0; i < vertCount; i++) {
+		glm::vec3 d = unpackPosition(verts[i], scale, bias) - center;
+		radius2 = std::max(radius2, glm::dot(d, d));
+	}
+	sphere = glm::vec4(center, sqrtf(radius2));
+}
+
+void computeMeshBounds(int ObjectId, const PackedVertex* verts, size_t vertCount) {
+	measureMesh(verts, vertCount, PositionScale[ObjectId], PositionBias[ObjectId], MeshBoundsMin[ObjectId], MeshBoundsMax[ObjectId], MeshSphere[ObjectId]);
+}
+
+// Left, right, bottom, top, near and far planes of a view-projection matrix (Gribb/Hartmann)
+void extractFrustumPlanes(const glm::mat4 &viewProjection) {
+	glm::vec4 row[4];
+	for (int r = 0; r < 4; r++)
+		row[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+	for (int axis = 0; axis < 3; axis++) {
+		FrustumPlanes[2 * axis] = row[3] + row[axis];
+		FrustumPlanes[2 * axis + 1] = row[3] - row[axis];
+	}
+	for (int i = 0; i < 6; i++)
+		FrustumPlanes[i] = FrustumPlanes[i] * (1.0f / glm::length(glm::vec3(FrustumPlanes[i])));
+}
+
+// Sphere test first; only a sphere straddling a plane falls back to the world-space box of the part
+bool partVisible(int ObjectId, const glm::mat4 &world) {
+	glm::vec3 center = glm::vec3(world * glm::vec4(glm::vec3(MeshSphere[ObjectId]), 1.0f));
+	float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+	float radius = MeshSphere[ObjectId].w * scale;
+	bool straddles = false;
+	for (int i = 0; i < 6; i++) {
+		float d = glm::dot(glm::vec3(FrustumPlanes[i]), center) + FrustumPlanes[i].w;
+		if (d < -radius)
+			return false;
+		if (d < radius)
+			straddles = true;
+	}
+	if (!straddles)
+		return true;
+
+	// Box center and half extents in world space; |M| maps the local extents onto world axes
+	glm::vec3 boxCenter = glm::vec3(world * glm::vec4((MeshBoundsMin[ObjectId] + MeshBoundsMax[ObjectId]) * 0.5f, 1.0f));
+	glm::vec3 half = (MeshBoundsMax[ObjectId] - MeshBoundsMin[ObjectId]) * 0.5f;
+	glm::vec3 extent;
+	for (int r = 0; r < 3; r++)
+		extent[r] = fabsf(world[0][r]) * half.x + fabsf(world[1][r]) * half.y + fabsf(world[2][r]) * half.z;
+	for (int i = 0; i < 6; i++) {
+		glm::vec3 n = glm::vec3(FrustumPlanes[i]);
+		float d = glm::dot(n, boxCenter) + FrustumPlanes[i].w;
+		float r = fabsf(n.x) * extent.x + fabsf(n.y) * extent.y + fabsf(n.z) * extent.z;
+		if (d < -r)
+			return false;
+	}
+	return true;
+}
+
+//-- LEVEL OF DETAIL --//
+
+// Quadric error metric (Garland/Heckbert): the sum of squared distances to a set of planes, stored
+// as the upper triangle of a symmetric 4x4 matrix: xx xy xz xw yy yz yw zz zw ww
+static void addPlaneQuadric(double* q, const glm::vec3 &n, float d, double weight) {
+	double p[4] = { n.x, n.y, n.z, d };
+	int k = 0;
+	for (int r = 0; r < 4; r++)
+		for (int c = r; c < 4; c++)
+			q[k++] += weight * p[r] * p[c];
+}
+
+static double quadricError(const double* a, const double* b, const glm::vec3 &v) {
+	double q[10];
+	for (int k = 0; k < 10; k++)
+		q[k] = a[k] + b[k];
+	double x = v.x, y = v.y, z = v.z;
+	return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+		+ q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+		+ q[7] * z * z + 2 * q[8] * z + q[9];
+}
+
+// Half-edge collapse of From onto To; the queue pops the cheapest first. Stamps go stale when
+// either endpoint's quadric changes, so outdated entries are skipped instead of removed.
+struct LodCollapse {
+	double Cost;
+	int From, To;
+	unsigned int FromStamp, ToStamp;
+	bool operator<(const LodCollapse &other) const { return Cost > other.Cost; }
+};
+
+// Appends coarser levels to indices (which holds level 0) and fills lods. Collapses work on
+// vertices merged by quantized position, so flat-shaded seams stay closed, and only ever move a
+// vertex onto an existing one: every level indexes the same vertex buffer.
+void generateLods(const PackedVertex* verts, size_t vertCount, StagingVector<GLushort> &indices, const glm::vec4 &scale, const glm::vec4 &bias, MeshLods &lods) {
+	memset(&lods, 0, sizeof(lods));
+	lods.Count = 1;
+	lods.Indices[0] = (unsigned int)indices.size();
+	int triCount = (int)indices.size() / 3;
+	if (triCount < LodMinTriangles)
+		return;
+
+	std::map<unsigned long long, int, std::less<unsigned long long>, StagingAllocator<std::pair<const unsigned long long, int> > > positionGroup;
+	StagingVector<int> group(vertCount);
+	StagingVector<int> groupVertex;	// a vertex of the group, used for corners collapsed onto it
+	StagingVector<glm::vec3> groupPos;
+	glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+	for (size_t i = 0; i < vertCount; i++) {
+		unsigned long long key = verts[i].Position[0] | (unsigned long long)verts[i].Position[1] << 16 | (unsigned long long)verts[i].Position[2] << 32;
+		auto it = positionGroup.find(key);
+		if (it == positionGroup.end()) {
+			it = positionGroup.insert(std::make_pair(key, (int)groupVertex.size())).first;
+			groupVertex.push_back((int)i);
+			groupPos.push_back(unpackPosition(verts[i], scale, bias));
+			lo = glm::vec3(std::min(lo.x, groupPos.back().x), std::min(lo.y, groupPos.back().y), std::min(lo.z, groupPos.back().z));
+			hi = glm::vec3(std::max(hi.x, groupPos.back().x), std::max(hi.y, groupPos.back().y), std::max(hi.z, groupPos.back().z));
+		}
+		group[i] = it->second;
+	}
+	int groups = (int)groupVertex.size();
+	float maxError = LodMaxError * glm::length(hi - lo);
+
+	StagingVector<int> corners(indices.begin(), indices.end());
+	StagingVector<unsigned char> triAlive(triCount, 1);
+	StagingVector<StagingVector<int> > groupTris(groups);
+	StagingVector<double> quadrics(groups * 10, 0.0);
+	std::map<std::pair<int, int>, int, std::less<std::pair<int, int> >, StagingAllocator<std::pair<const std::pair<int, int>, int> > > edgeUse;
+	int live = 0;
+	for (int t = 0; t < triCount; t++) {
+		int g0 = group[corners[3 * t]], g1 = group[corners[3 * t + 1]], g2 = group[corners[3 * t + 2]];
+		glm::vec3 n = glm::cross(groupPos[g1] - groupPos[g0], groupPos[g2] - groupPos[g0]);
+		float length = glm::length(n);
+		if (g0 == g1 || g1 == g2 || g0 == g2 || length == 0.0f) {
+			triAlive[t] = 0;
+			continue;
+		}
+		live++;
+		n = n * (1.0f / length);
+		int g[3] = { g0, g1, g2 };
+		for (int k = 0; k < 3; k++) {
+			addPlaneQuadric(&quadrics[10 * g[k]], n, -glm::dot(n, groupPos[g0]), 1.0);
+			groupTris[g[k]].push_back(t);
+			edgeUse[std::make_pair(std::min(g[k], g[(k + 1) % 3]), std::max(g[k], g[(k + 1) % 3]))]++;
+		}
+	}
+
+	// Open edges get a plane through them, perpendicular to their triangle, so borders keep their shape
+	for (int t = 0; t < triCount; t++) {
+		if (!triAlive[t])
+			continue;
+		int g[3] = { group[corners[3 * t]], group[corners[3 * t + 1]], group[corners[3 * t + 2]] };
+		glm::vec3 n = glm::normalize(glm::cross(groupPos[g[1]] - groupPos[g[0]], groupPos[g[2]] - groupPos[g[0]]));
+		for (int k = 0; k < 3; k++) {
+			int a = g[k], b = g[(k + 1) % 3];
+			if (edgeUse[std::make_pair(std::min(a, b), std::max(a, b))] != 1)
+				continue;
+			glm::vec3 side = glm::normalize(glm::cross(groupPos[b] - groupPos[a], n));
+			addPlaneQuadric(&quadrics[10 * a], side, -glm::dot(side, groupPos[a]), LodBoundaryWeight);
+			addPlaneQuadric(&quadrics[10 * b], side, -glm::dot(side, groupPos[a]), LodBoundaryWeight);
+		}
+	}
+
+	StagingVector<unsigned int> stamp(groups, 0);
+	StagingVector<unsigned char> groupAlive(groups, 1);
+	std::priority_queue<LodCollapse, StagingVector<LodCollapse> > queue;
+	for (int t = 0; t < triCount; t++) {
+		if (!triAlive[t])
+			continue;
+		for (int k = 0; k < 3; k++) {
+			int a = group[corners[3 * t + k]], b = group[corners[3 * t + (k + 1) % 3]];
+			LodCollapse ab = { quadricError(&quadrics[10 * a], &quadrics[10 * b], groupPos[b]), a, b, 0, 0 };
+			LodCollapse ba = { quadricError(&quadrics[10 * a], &quadrics[10 * b], groupPos[a]), b, a, 0, 0 };
+			queue.push(ab);
+			queue.push(ba);
+		}
+	}
+
+	double worstCost = 0.0;
+	int target = triCount / 2;
+	// Rings are reused by every collapse, since the load arena never takes memory back
+	StagingVector<int> ringU, ringV;
+	while (lods.Count < MaxLods && !queue.empty()) {
+		ringU.clear();
+		ringV.clear();
+		LodCollapse c = queue.top();
+		queue.pop();
+		int u = c.From, v = c.To;
+		if (!groupAlive[u] || !groupAlive[v] || stamp[u] != c.FromStamp || stamp[v] != c.ToStamp)
+			continue;
+		if (c.Cost > (double)maxError * maxError)
+			break;
+
+		// u and v may only share the two neighbors across their edge (link condition), and no
+		// triangle that survives the collapse may flip or degenerate
+		for (size_t i = 0; i < groupTris[u].size(); i++) {
+			int t = groupTris[u][i];
+			for (int k = 0; triAlive[t] && k < 3; k++)
+				ringU.push_back(group[corners[3 * t + k]]);
+		}
+		for (size_t i = 0; i < groupTris[v].size(); i++) {
+			int t = groupTris[v][i];
+			for (int k = 0; triAlive[t] && k < 3; k++)
+				ringV.push_back(group[corners[3 * t + k]]);
+		}
+		std::sort(ringU.begin(), ringU.end());
+		ringU.erase(std::unique(ringU.begin(), ringU.end()), ringU.end());
+		std::sort(ringV.begin(), ringV.end());
+		ringV.erase(std::unique(ringV.begin(), ringV.end()), ringV.end());
+		int shared = 0;
+		for (size_t i = 0; i < ringU.size(); i++)
+			if (ringU[i] != u && ringU[i] != v && std::binary_search(ringV.begin(), ringV.end(), ringU[i]))
+				shared++;
+		bool valid = shared <= 2;
+		for (size_t i = 0; valid && i < groupTris[u].size(); i++) {
+			int t = groupTris[u][i];
+			if (!triAlive[t])
+				continue;
+			glm::vec3 p[3], q[3];
+			bool hasV = false;
+			for (int k = 0; k < 3; k++) {
+				int g = group[corners[3 * t + k]];
+				hasV = hasV || g == v;
+				p[k] = groupPos[g];
+				q[k] = g == u ? groupPos[v] : p[k];
+			}
+			if (hasV)
+				continue;
+			glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+			valid = glm::dot(before, after) > 0.2f * glm::length(before) * glm::length(after);
+		}
+		if (!valid)
+			continue;
+
+		for (size_t i = 0; i < groupTris[u].size(); i++) {
+			int t = groupTris[u][i];
+			if (!triAlive[t])
+				continue;
+			bool hasV = false;
+			for (int k = 0; k < 3; k++)
+				hasV = hasV || group[corners[3 * t + k]] == v;
+			if (hasV) {
+				triAlive[t] = 0;
+				live--;
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+				if (group[corners[3 * t + k]] == u)
+					corners[3 * t + k] = groupVertex[v];
+			groupTris[v].push_back(t);
+		}
+		for (int k = 0; k < 10; k++)
+			quadrics[10 * v + k] += quadrics[10 * u + k];
+		groupAlive[u] = 0;
+		stamp[v]++;
+		worstCost = std::max(worstCost, c.Cost);
+
+		// Edges at v changed cost; queue them again with the new stamp
+		for (size_t i = 0; i < groupTris[v].size(); i++) {
+			int t = groupTris[v][i];
+			for (int k = 0; triAlive[t] && k < 3; k++) {
+				int w = group[corners[3 * t + k]];
+				if (w == v)
+					continue;
+				LodCollapse vw = { quadricError(&quadrics[10 * v], &quadrics[10 * w], groupPos[w]), v, w, stamp[v], stamp[w] };
+				LodCollapse wv = { quadricError(&quadrics[10 * v], &quadrics[10 * w], groupPos[v]), w, v, stamp[w], stamp[v] };
+				queue.push(vw);
+				queue.push(wv);
+			}
+		}
+
+		if (live <= target) {
+			int level = lods.Count++;
+			lods.First[level] = (unsigned int)indices.size();
+			for (int t = 0; t < triCount; t++)
+				for (int k = 0; triAlive[t] && k < 3; k++)
+					indices.push_back((GLushort)corners[3 * t + k]);
+			lods.Indices[level] = (unsigned int)indices.size() - lods.First[level];
+			lods.Error[level] = (float)sqrt(worstCost);
+			target = live / 2;
+		}
+	}
+}
+
+// Coarsest level whose error, at the part's nearest distance to the camera, projects to at most
+// LodPixelError pixels. Switching to a coarser level than last frame's needs the hysteresis margin.
+int selectLod(int node, int ObjectId, const glm::mat4 &world) {
+	const MeshLods &lods = ObjectLods[ObjectId];
+	glm::vec3 center = glm::vec3(world * glm::vec4(glm::vec3(MeshSphere[ObjectId]), 1.0f));
+	float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+	float distance = std::max(glm::length(center - CameraPosition) - MeshSphere[ObjectId].w * scale, 0.1f);
+	float pixelsPerUnit = gProjectionMatrix[1][1] * window_height * 0.5f / distance;
+
+	int level = 0;
+	for (unsigned int l = 1; l < lods.Count; l++) {
+		float pixels = lods.Error[l] * scale * pixelsPerUnit;
+		if (pixels <= ((int)l > NodeLod[node] ? LodPixelError * LodHysteresis : LodPixelError))
+			level = l;
+	}
+	NodeLod[node] = level;
+	return level;
+}
+
+// Ensure your .obj files are in the correct format and properly loaded by looking at the following function
+bool parseObject(const char* file, StagingVector<PackedVertex> &out_Vertices, StagingVector<GLushort> &out_Indices, glm::vec3 &boundsMin, glm::vec3 &boundsMax, MeshLods &lods) {
+	// Read our .obj file
+	StagingVector<glm::vec3> vertices;
+	StagingVector<glm::vec3> normals;
+	bool res = loadOBJParallel(file, vertices, normals, 0);
+
+	StagingVector<unsigned int> indices;
+	StagingVector<glm::vec3> indexed_vertices;
+	StagingVector<glm::vec3> indexed_normals;
+	weldVertices(vertices.data(), normals.data(), vertices.size(), WeldEpsilon, indices, indexed_vertices, indexed_normals);
+
+	if (indexed_vertices.size() > 0xFFFF) {
+		fprintf(stderr, "%s has %d vertices, more than 16-bit indices can address\n", file, (int)indexed_vertices.size());
+		res = false;
+	}
+
+	// populate output arrays
+	out_Vertices.resize(indexed_vertices.size());
+	packVertices(indexed_vertices, indexed_normals, out_Vertices.data(), boundsMin, boundsMax);
+	out_Indices.assign(indices.begin(), indices.end());
+	generateLods(out_Vertices.data(), out_Vertices.size(), out_Indices, glm::vec4((boundsMax - boundsMin) / 65535.0f, 0.0f), glm::vec4(boundsMin, 0.0f), lods);
+	return res;
+}
+
+//-- VERTEX WELDING --//
+
+// Spatial hash over position cells of size epsilon. Two positions within epsilon per component
+// always land in the same or a neighboring cell, so only 27 cells are searched per vertex.
+struct WeldCell {
+	long long x, y, z;
+	int head;	// most recent output vertex in this cell, -1 if the slot is empty
+};
+
+static inline size_t weldHash(long long x, long long y, long long z) {
+	unsigned long long h = (unsigned long long)x * 73856093ULL ^ (unsigned long long)y * 19349663ULL ^ (unsigned long long)z * 83492791ULL;
+	return (size_t)(h ^ (h >> 29));
+}
+
+static inline long long weldCoord(float v, float epsilon) {
+	return (long long)floor((double)v / (double)epsilon);
+}
+
+static inline bool weldNear(const glm::vec3 &a, const glm::vec3 &b, float epsilon) {
+	return fabs(a.x - b.x) < epsilon && fabs(a.y - b.y) < epsilon && fabs(a.z - b.z) < epsilon;
+}
+
+// Merges vertices whose position and normal match within epsilon. The result is identical to the
+// linear search in indexVBO (each vertex maps to the first earlier match), but runs in O(n).
+void weldVertices(const glm::vec3* in_vertices, const glm::vec3* in_normals, size_t count, float epsilon,
+	StagingVector<unsigned int> &out_indices, StagingVector<glm::vec3> &out_vertices, StagingVector<glm::vec3> &out_normals) {
+	out_indices.clear();
+	out_vertices.clear();
+	out_normals.clear();
+	out_indices.reserve(count);
+
+	size_t capacity = 64;
+	while (capacity < count * 2)
+		capacity <<= 1;
+	StagingVector<WeldCell> cells(capacity);
+	for (size_t i = 0; i < capacity; i++)
+		cells[i].head = -1;
+	StagingVector<int> next;	// chains output vertices that share a cell
+	size_t usedCells = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		const glm::vec3 &v = in_vertices[i];
+		const glm::vec3 &n = in_normals[i];
+		long long cx = weldCoord(v.x, epsilon), cy = weldCoord(v.y, epsilon), cz = weldCoord(v.z, epsilon);
+
+		// Lowest matching index across the neighborhood, as the linear search would find
+		int match = -1;
+		for (long long dx = -1; dx <= 1; dx++) {
+			for (long long dy = -1; dy <= 1; dy++) {
+				for (long long dz = -1; dz <= 1; dz++) {
+					size_t slot = weldHash(cx + dx, cy + dy, cz + dz) & (capacity - 1);
+					while (cells[slot].head != -1 && !(cells[slot].x == cx + dx && cells[slot].y == cy + dy && cells[slot].z == cz + dz))
+						slot = (slot + 1) & (capacity - 1);
+					for (int k = cells[slot].head; k != -1; k = next[k]) {
+						if ((match == -1 || k < match) && weldNear(v, out_vertices[k], epsilon) && weldNear(n, out_normals[k], epsilon))
+							match = k;
+					}
+				}
+			}
+		}
+		if (match != -1) {
+			out_indices.push_back((unsigned int)match);
+			continue;
+		}
+
+		int index = (int)out_vertices.size();
+		out_vertices.push_back(v);
+		out_normals.push_back(n);
+		out_indices.push_back((unsigned int)index);
+
+		size_t slot = weldHash(cx, cy, cz) & (capacity - 1);
+		while (cells[slot].head != -1 && !(cells[slot].x == cx && cells[slot].y == cy && cells[slot].z == cz))
+			slot = (slot + 1) & (capacity - 1);
+		if (cells[slot].head == -1) {
+			cells[slot].x = cx;
+			cells[slot].y = cy;
+			cells[slot].z = cz;
+			usedCells++;
+		}
+		next.push_back(cells[slot].head);
+		cells[slot].head = index;
+
+		// Keep the table at most half full
+		if (usedCells * 2 > capacity) {
+			StagingVector<WeldCell> old;
+			old.swap(cells);
+			capacity <<= 1;
+			cells.resize(capacity);
+			for (size_t c = 0; c < capacity; c++)
+				cells[c].head = -1;
+			for (size_t c = 0; c < old.size(); c++) {
+				if (old[c].head == -1)
+					continue;
+				size_t to = weldHash(old[c].x, old[c].y, old[c].z) & (capacity - 1);
+				while (cells[to].head != -1)
+					to = (to + 1) & (capacity - 1);
+				cells[to] = old[c];
+			}
+		}
+	}
+}
+
+// Expanded (per-corner) height field with smooth normals: about 2 * n * n triangles
+static void makeWeldBenchMesh(size_t triangles, std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals) {
+	int n = (int)ceil(sqrt(triangles / 2.0));
+	vertices.clear();
+	normals.clear();
+	vertices.reserve((size_t)n * n * 6);
+	normals.reserve((size_t)n * n * 6);
+	const int corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			for (int c = 0; c < 6; c++) {
+				float x = (float)(i + corners[c][0]) * 0.05f;
+				float z = (float)(j + corners[c][1]) * 0.05f;
+				vertices.push_back(glm::vec3(x, sin(x) * cos(z), z));
+				normals.push_back(glm::normalize(glm::vec3(-cos(x) * cos(z), 1.0f, sin(x) * sin(z))));
+			}
+		}
+	}
+}
+
+// --bench-weld [max stock triangles]: checks the hashed welder against indexVBO on the scene
+// meshes, then times both on synthetic meshes of 10k to 1M triangles
+int benchWeld(int maxStockTriangles) {
+	const char* sceneMeshes[] = { "Base.obj", "Top.obj", "Arm1.obj", "Joint.obj", "Arm2.obj", "Pen.obj", "Button.obj", "Solid.obj" };
+	int mismatches = 0;
+	for (size_t m = 0; m < sizeof(sceneMeshes) / sizeof(sceneMeshes[0]); m++) {
+		std::vector<glm::vec3> vertices, normals;
+		if (!loadOBJ(sceneMeshes[m], vertices, normals))
+			continue;
+		std::vector<GLushort> stockIndices;
+		std::vector<glm::vec3> stockVertices, stockNormals;
+		indexVBO(vertices, normals, stockIndices, stockVertices, stockNormals);
+		StagingVector<unsigned int> indices;
+		StagingVector<glm::vec3> weldedVertices, weldedNormals;
+		weldVertices(vertices.data(), normals.data(), vertices.size(), WeldEpsilon, indices, weldedVertices, weldedNormals);
+
+		bool same = stockIndices.size() == indices.size() && stockVertices.size() == weldedVertices.size();
+		for (size_t i = 0; same && i < indices.size(); i++)
+			same = stockIndices[i] == indices[i];
+		for (size_t i = 0; same && i < weldedVertices.size(); i++)
+			same = stockVertices[i] == weldedVertices[i] && stockNormals[i] == weldedNormals[i];
+		printf("%-12s %6d -> %5d vertices  %s\n", sceneMeshes[m], (int)vertices.size(), (int)weldedVertices.size(), same ? "identical" : "DIFFERS");
+		if (!same)
+			mismatches++;
+	}
+
+	printf("\n%10s %12s %12s %14s\n", "triangles", "vertices", "hashed ms", "indexVBO ms");
+	const size_t sizes[] = { 10000, 30000, 100000, 300000, 1000000 };
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		std::vector<glm::vec3> vertices, normals;
+		makeWeldBenchMesh(sizes[s], vertices, normals);
+
+		StagingVector<unsigned int> indices;
+		StagingVector<glm::vec3> weldedVertices, weldedNormals;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		weldVertices(vertices.data(), normals.data(), vertices.size(), WeldEpsilon, indices, weldedVertices, weldedNormals);
+		double hashedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// The stock indexer is quadratic and limited to 16-bit indices, so only time it on small meshes
+		char stock[32] = "skipped";
+		if (vertices.size() / 3 <= (size_t)maxStockTriangles && weldedVertices.size() <= 0xFFFF) {
+			std::vector<GLushort> stockIndices;
+			std::vector<glm::vec3> stockVertices, stockNormals;
+			start = std::chrono::high_resolution_clock::now();
+			indexVBO(vertices, normals, stockIndices, stockVertices, stockNormals);
+			double stockMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			bool same = stockVertices.size() == weldedVertices.size() && stockIndices.size() == indices.size();
+			for (size_t i = 0; same && i < indices.size(); i++)
+				same = stockIndices[i] == indices[i];
+			snprintf(stock, sizeof(stock), "%.1f%s", stockMs, same ? "" : " DIFFERS");
+			if (!same)
+				mismatches++;
+		}
+		printf("%10d %12d %12.1f %14s\n", (int)(vertices.size() / 3), (int)weldedVertices.size(), hashedMs, stock);
+	}
+	return mismatches == 0 ? 0 : 1;
+}
+
+//-- STAGING ARENA --//
+
+thread_local LinearArena* CurrentArena = NULL;
+LinearArena LoadArena;	// mesh loading on the main thread
+
+// Every C++ heap allocation is counted, so benchmarks can check that a path stays off the heap
+std::atomic<size_t> HeapAllocations(0);
+
+void* operator new(size_t size) {
+	HeapAllocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(size != 0 ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+// Kept out of line: GCC would otherwise see the free() of an operator new pointer and warn
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+void* arenaAlloc(LinearArena &arena, size_t bytes) {
+	bytes = (bytes + 15) & ~(size_t)15;
+	if (arena.Blocks.empty() || arena.Used + bytes > arena.Blocks.back().Size) {
+		size_t size = std::max(bytes, std::max((size_t)1 << 16, arena.Blocks.empty() ? 0 : arena.Blocks.back().Size * 2));
+		ArenaBlock block = { new unsigned char[size], size };
+		arena.Blocks.push_back(block);
+		arena.Used = 0;
+	}
+	void* p = arena.Blocks.back().Data + arena.Used;
+	arena.Used += bytes;
+	arena.RoundBytes += bytes;
+	return p;
+}
+
+void arenaReset(LinearArena &arena) {
+	arena.PeakBytes = std::max(arena.PeakBytes, arena.RoundBytes);
+	if (arena.Blocks.size() > 1) {
+		size_t peak = arena.PeakBytes;
+		arenaRelease(arena);
+		ArenaBlock block = { new unsigned char[peak], peak };
+		arena.Blocks.push_back(block);
+		arena.PeakBytes = peak;
+	}
+	arena.Used = 0;
+	arena.RoundBytes = 0;
+}
+
+void arenaRelease(LinearArena &arena) {
+	for (size_t i = 0; i < arena.Blocks.size(); i++)
+		delete[] arena.Blocks[i].Data;
+	arena.Blocks.clear();
+	arena.Used = 0;
+	arena.RoundBytes = 0;
+	arena.PeakBytes = 0;
+}
+
+// --bench-reload [rounds]: reloads every scene mesh from its .obj without a GL context (parse,
+// weld, LODs, bounds, BVH) and counts heap allocations per round. Once the first round has sized
+// the staging arena and the BVHs, later rounds should not allocate at all.
+int benchReload(int rounds) {
+	const char* files[] = { "Base.obj", "Top.obj", "Arm1.obj", "Joint.obj", "Arm2.obj", "Pen.obj", "Button.obj", "Solid.obj" };
+	size_t steadyAllocations = 0;
+	for (int round = 0; round < rounds; round++) {
+		size_t before = HeapAllocations.load();
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < 8; i++) {
+			int ObjectId = 2 + i;
+			ArenaScope scope(LoadArena);
+			StagingVector<PackedVertex> verts;
+			StagingVector<GLushort> idcs;
+			glm::vec3 boundsMin, boundsMax;
+			if (!parseObject(files[i], verts, idcs, boundsMin, boundsMax, ObjectLods[ObjectId]))
+				return 1;
+			setMeshBounds(ObjectId, boundsMin, boundsMax);
+			computeMeshBounds(ObjectId, verts.data(), verts.size());
+			buildMeshBVH(PickMeshes[ObjectId], verts.data(), verts.size(), idcs.data(), ObjectLods[ObjectId].Indices[0],
+				PositionScale[ObjectId], PositionBias[ObjectId]);
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		size_t allocations = HeapAllocations.load() - before;
+		if (round >= 2)
+			steadyAllocations += allocations;
+		if (round < 3 || round == rounds - 1)
+			printf("round %4d  %7.3f ms  %6d heap allocations\n", round, ms, (int)allocations);
+	}
+	printf("staging arena: %d block, %d bytes peak per mesh; %d allocations after round 1\n",
+		(int)LoadArena.Blocks.size(), (int)LoadArena.PeakBytes, (int)steadyAllocations);
+	arenaRelease(LoadArena);
+	stopWorkers();
+	return steadyAllocations == 0 ? 0 : 1;
+}
+
+//-- WORKER POOL --//
+
+// Persistent worker threads for data-parallel loops. runParallel() hands out job indices
+// [0, count) to a pool's workers and the calling thread, and returns once all of them are done.
+// Loops on one pool run one at a time, so per-frame work has its own pool and never queues behind
+// a mesh parse on a loader or the hot reload watcher.
+struct WorkerPool {
+	std::vector<std::thread> Workers;
+	std::mutex Mutex;
+	std::condition_variable Wake;
+	std::condition_variable Idle;
+	ParallelJob Job;
+	void* Context;
+	int JobCount;
+	int Active;	// workers allowed to take part in the current loop
+	int Busy;	// workers currently inside a loop
+	unsigned int Generation;
+	bool Quit;
+	std::atomic<int> NextJob;
+	std::atomic<int> JobsDone;
+	std::mutex CallMutex;	// serializes the threads that share the pool
+	WorkerPool() : Context(NULL), JobCount(0), Active(0), Busy(0), Generation(0), Quit(false) {}
+};
+WorkerPool LoaderPool;	// OBJ parsing on loaders, the watcher and the benchmarks
+WorkerPool FramePool;	// per-frame work of the render thread (or the scene thread)
+
+static void drainJobs(WorkerPool &pool, ParallelJob job, void* context, int count) {
+	for (int i = pool.NextJob.fetch_add(1); i < count; i = pool.NextJob.fetch_add(1)) {
+		job(context, i);
+		pool.JobsDone.fetch_add(1);
+	}
+}
+
+static void workerMain(WorkerPool* pool, int id) {
+	unsigned int seen = 0;
+	std::unique_lock<std::mutex> lock(pool->Mutex);
+	while (true) {
+		pool->Wake.wait(lock, [&] { return pool->Quit || pool->Generation != seen; });
+		if (pool->Quit)
+			return;
+		seen = pool->Generation;
+		if (id >= pool->Active)
+			continue;
+		ParallelJob job = pool->Job;
+		void* context = pool->Context;
+		int count = pool->JobCount;
+		pool->Busy++;
+		lock.unlock();
+		drainJobs(*pool, job, context, count);
+		lock.lock();
+		if (--pool->Busy == 0)
+			pool->Idle.notify_all();
+	}
+}
+
+// threads <= 0 uses every core
+void runParallel(WorkerPool &pool, int count, ParallelJob job, void* context, int threads) {
+	std::lock_guard<std::mutex> serial(pool.CallMutex);
+	if (pool.Workers.empty()) {
+		int cores = (int)std::thread::hardware_concurrency();
+		for (int i = 0; i < cores - 1; i++)
+			pool.Workers.push_back(std::thread(workerMain, &pool, i));
+	}
+	if (threads <= 0 || threads > (int)pool.Workers.size() + 1)
+		threads = (int)pool.Workers.size() + 1;
+	if (count <= 0)
+		return;
+	if (threads == 1 || count == 1) {
+		for (int i = 0; i < count; i++)
+			job(context, i);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(pool.Mutex);
+		pool.Idle.wait(lock, [&pool] { return pool.Busy == 0; });
+		pool.Job = job;
+		pool.Context = context;
+		pool.JobCount = count;
+		pool.Active = threads - 1;
+		pool.NextJob = 0;
+		pool.JobsDone = 0;
+		pool.Generation++;
+	}
+	pool.Wake.notify_all();
+	drainJobs(pool, job, context, count);
+
+	std::unique_lock<std::mutex> lock(pool.Mutex);
+	pool.Idle.wait(lock, [&pool, count] { return pool.Busy == 0 && pool.JobsDone.load() == count; });
+}
+
+static void stopPool(WorkerPool &pool) {
+	{
+		std::lock_guard<std::mutex> lock(pool.Mutex);
+		pool.Quit = true;
+	}
+	pool.Wake.notify_all();
+	for (size_t i = 0; i < pool.Workers.size(); i++)
+		pool.Workers[i].join();
+	pool.Workers.clear();
+	pool.Quit = false;
+}
+
+void stopWorkers(void) {
+	stopPool(LoaderPool);
+	stopPool(FramePool);
+}
+
+//-- PARALLEL OBJ PARSER --//
+
+// The file is split into chunks at line boundaries. Pass 1 counts v/vn/face corners per chunk,
+// a prefix sum gives every chunk its slice of the output, pass 2 parses each chunk straight into
+// its slice, and pass 3 expands the face corners. Every value lands at the same position as in a
+// sequential parse, so the result does not depend on the number of threads.
+struct ObjChunk {
+	const char* Begin;
+	const char* End;
+	size_t NumV, NumVn, NumCorners;
+	size_t FirstV, FirstVn, FirstCorner;
+	bool Failed;
+};
+
+struct ObjParse {
+	StagingVector<ObjChunk> Chunks;
+	StagingVector<glm::vec3> V;
+	StagingVector<glm::vec3> Vn;
+	StagingVector<int> CornerV;	// 0-based, resolved from 1-based or negative OBJ indices
+	StagingVector<int> CornerVn;	// -1 when the face has no normal
+	glm::vec3* OutVertices;
+	glm::vec3* OutNormals;
+	size_t CornersPerJob;
+	std::atomic<bool> Failed;	// set by any corner job that meets a bad index
+};
+
+static inline const char* objSkipSpace(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		p++;
+	return p;
+}
+
+static inline const char* objLineEnd(const char* p, const char* end) {
+	const char* nl = (const char*)memchr(p, '\n', end - p);
+	return nl != NULL ? nl : end;
+}
+
+static inline const char* objFloat(const char* p, const char* end, float &out, bool &ok) {
+	p = objSkipSpace(p, end);
+	if (p < end && *p == '+')
+		p++;
+	std::from_chars_result r = std::from_chars(p, end, out);
+	if (r.ec != std::errc())
+		ok = false;
+	return r.ptr;
+}
+
+// Number of vertices of the face on this line ("f a b c ..."), counted by whitespace separated tokens
+static inline size_t objFaceSize(const char* p, const char* end) {
+	size_t n = 0;
+	while (true) {
+		p = objSkipSpace(p, end);
+		if (p >= end || *p == '#')
+			return n;
+		n++;
+		while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+			p++;
+	}
+}
+
+static inline int objIndex(int value, size_t count) {
+	return value > 0 ? value - 1 : (int)count + value;
+}
+
+static void objCountChunk(void* context, int index) {
+	ObjChunk &chunk = ((ObjParse*)context)->Chunks[index];
+	chunk.NumV = chunk.NumVn = chunk.NumCorners = 0;
+	for (const char* line = chunk.Begin; line < chunk.End; ) {
+		const char* end = objLineEnd(line, chunk.End);
+		const char* p = objSkipSpace(line, end);
+		if (end - p > 1 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+			chunk.NumV++;
+		else if (end - p > 2 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+			chunk.NumVn++;
+		else if (end - p > 1 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+			size_t n = objFaceSize(p + 1, end);
+			if (n >= 3)
+				chunk.NumCorners += 3 * (n - 2);
+		}
+		line = end + 1;
+	}
+}
+
+static void objParseChunk(void* context, int index) {
+	ObjParse &parse = *(ObjParse*)context;
+	ObjChunk &chunk = parse.Chunks[index];
+	size_t v = chunk.FirstV, vn = chunk.FirstVn, corner = chunk.FirstCorner;
+	bool ok = true;
+	for (const char* line = chunk.Begin; line < chunk.End && ok; ) {
+		const char* end = objLineEnd(line, chunk.End);
+		const char* p = objSkipSpace(line, end);
+		if (end - p > 1 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+			glm::vec3 &out = parse.V[v++];
+			p = objFloat(p + 1, end, out.x, ok);
+			p = objFloat(p, end, out.y, ok);
+			p = objFloat(p, end, out.z, ok);
+		}
+		else if (end - p > 2 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+			glm::vec3 &out = parse.Vn[vn++];
+			p = objFloat(p + 2, end, out.x, ok);
+			p = objFloat(p, end, out.y, ok);
+			p = objFloat(p, end, out.z, ok);
+		}
+		else if (end - p > 1 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+			// v, v/vt, v//vn or v/vt/vn per corner; polygons are triangulated as a fan
+			int first[2] = { 0, 0 }, prev[2] = { 0, 0 };
+			int n = 0;
+			p++;
+			while (ok) {
+				p = objSkipSpace(p, end);
+				if (p >= end || *p == '#')
+					break;
+				int vi = 0, ni = 0, ti = 0;
+				std::from_chars_result r = std::from_chars(p, end, vi);
+				ok = r.ec == std::errc() && vi != 0;
+				p = r.ptr;
+				if (ok && p < end && *p == '/') {
+					p++;
+					if (p < end && *p != '/') {
+						r = std::from_chars(p, end, ti);
+						p = r.ptr;
+					}
+					if (p < end && *p == '/') {
+						r = std::from_chars(p + 1, end, ni);
+						ok = r.ec == std::errc();
+						p = r.ptr;
+					}
+				}
+				int cur[2] = { objIndex(vi, v), ni != 0 ? objIndex(ni, vn) : -1 };
+				if (n == 0) {
+					first[0] = cur[0];
+					first[1] = cur[1];
+				}
+				else if (n >= 2) {
+					parse.CornerV[corner] = first[0];
+					parse.CornerVn[corner++] = first[1];
+					parse.CornerV[corner] = prev[0];
+					parse.CornerVn[corner++] = prev[1];
+					parse.CornerV[corner] = cur[0];
+					parse.CornerVn[corner++] = cur[1];
+				}
+				prev[0] = cur[0];
+				prev[1] = cur[1];
+				n++;
+			}
+		}
+		line = end + 1;
+	}
+	chunk.Failed = !ok;
+}
+
+static void objExpandCorners(void* context, int index) {
+	ObjParse &parse = *(ObjParse*)context;
+	size_t begin = (size_t)index * parse.CornersPerJob;
+	size_t end = std::min(begin + parse.CornersPerJob, parse.CornerV.size());
+	const glm::vec3 zero(0.0f, 0.0f, 0.0f);
+	for (size_t i = begin; i < end; i++) {
+		int vi = parse.CornerV[i], ni = parse.CornerVn[i];
+		if (vi < 0 || (size_t)vi >= parse.V.size() || ni >= (int)parse.Vn.size()) {
+			parse.Failed = true;
+			continue;
+		}
+		parse.OutVertices[i] = parse.V[vi];
+		parse.OutNormals[i] = ni >= 0 ? parse.Vn[ni] : zero;
+	}
+}
+
+// Drop-in replacement for loadOBJ: fills per-corner positions and normals of every triangle.
+// threads <= 0 uses every core.
+bool loadOBJParallel(const char* path, StagingVector<glm::vec3> &out_vertices, StagingVector<glm::vec3> &out_normals, int threads) {
+	MappedFile file;
+	if (!mapFile(path, file)) {
+		fprintf(stderr, "Impossible to open %s\n", path);
+		return false;
+	}
+
+	// Chunks of about 1 MB, a few per thread so uneven lines still balance
+	ObjParse parse;
+	parse.Failed = false;
+	const char* data = (const char*)file.Data;
+	const char* dataEnd = data + file.Size;
+	size_t chunkSize = std::max((size_t)1 << 20, file.Size / 256 + 1);
+	for (const char* begin = data; begin < dataEnd; ) {
+		const char* end = begin + std::min(chunkSize, (size_t)(dataEnd - begin));
+		end = end < dataEnd ? objLineEnd(end, dataEnd) : dataEnd;
+		if (end < dataEnd)
+			end++;
+		ObjChunk chunk;
+		memset(&chunk, 0, sizeof(chunk));
+		chunk.Begin = begin;
+		chunk.End = end;
+		parse.Chunks.push_back(chunk);
+		begin = end;
+	}
+
+	int numChunks = (int)parse.Chunks.size();
+	runParallel(LoaderPool, numChunks, objCountChunk, &parse, threads);
+	size_t numV = 0, numVn = 0, numCorners = 0;
+	for (int i = 0; i < numChunks; i++) {
+		parse.Chunks[i].FirstV = numV;
+		parse.Chunks[i].FirstVn = numVn;
+		parse.Chunks[i].FirstCorner = numCorners;
+		numV += parse.Chunks[i].NumV;
+		numVn += parse.Chunks[i].NumVn;
+		numCorners += parse.Chunks[i].NumCorners;
+	}
+	parse.V.resize(numV);
+	parse.Vn.resize(numVn);
+	parse.CornerV.resize(numCorners);
+	parse.CornerVn.resize(numCorners);
+	runParallel(LoaderPool, numChunks, objParseChunk, &parse, threads);
+	unmapFile(file);
+	for (int i = 0; i < numChunks; i++)
+		if (parse.Chunks[i].Failed)
+			parse.Failed = true;
+
+	if (!parse.Failed) {
+		out_vertices.resize(numCorners);
+		out_normals.resize(numCorners);
+		parse.OutVertices = out_vertices.data();
+		parse.OutNormals = out_normals.data();
+		parse.CornersPerJob = 1 << 16;
+		runParallel(LoaderPool, (int)((numCorners + parse.CornersPerJob - 1) / parse.CornersPerJob), objExpandCorners, &parse, threads);
+	}
+	if (parse.Failed) {
+		fprintf(stderr, "%s can't be read\n", path);
+		out_vertices.clear();
+		out_normals.clear();
+		return false;
+	}
+	return true;
+}
+
+// --bench-obj [file.obj]: checks the parallel parser against loadOBJ bit for bit and times it
+// with 1..N threads. Without a file a synthetic 1M triangle OBJ is written and used.
+int benchParse(const char* path) {
+	std::string generated;
+	if (path == NULL) {
+		generated = "bench_parse.obj";
+		path = generated.c_str();
+		std::vector<glm::vec3> vertices, normals;
+		makeWeldBenchMesh(1000000, vertices, normals);
+		FILE* out = fopen(path, "w");
+		if (out == NULL) {
+			fprintf(stderr, "Cannot write %s\n", path);
+			return 1;
+		}
+		for (size_t i = 0; i < vertices.size(); i++)
+			fprintf(out, "v %f %f %f\n", vertices[i].x, vertices[i].y, vertices[i].z);
+		for (size_t i = 0; i < normals.size(); i++)
+			fprintf(out, "vn %.6f %.6f %.6f\n", normals[i].x, normals[i].y, normals[i].z);
+		for (size_t i = 0; i < vertices.size(); i += 3)
+			fprintf(out, "f %d//%d %d//%d %d//%d\n", (int)i + 1, (int)i + 1, (int)i + 2, (int)i + 2, (int)i + 3, (int)i + 3);
+		fclose(out);
+	}
+
+	std::vector<glm::vec3> refVertices, refNormals;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	bool refOk = loadOBJ(path, refVertices, refNormals);
+	double refMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("%s: %d corners, loadOBJ %.1f ms\n", path, (int)refVertices.size(), refMs);
+
+	int failures = refOk ? 0 : 1;
+	int cores = (int)std::thread::hardware_concurrency();
+	for (int threads = 1; threads <= std::max(cores, 1); threads *= 2) {
+		StagingVector<glm::vec3> vertices, normals;
+		start = std::chrono::high_resolution_clock::now();
+		bool ok = loadOBJParallel(path, vertices, normals, threads);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		bool same = ok && vertices.size() == refVertices.size() && normals.size() == refNormals.size()
+			&& memcmp(vertices.data(), refVertices.data(), vertices.size() * sizeof(glm::vec3)) == 0
+			&& memcmp(normals.data(), refNormals.data(), normals.size() * sizeof(glm::vec3)) == 0;
+		printf("%3d threads %10.1f ms  %s\n", threads, ms, same ? "identical" : "DIFFERS");
+		if (!same)
+			failures++;
+		if (threads < cores && threads * 2 > cores)
+			threads = cores / 2;
+	}
+
+	if (!generated.empty())
+		remove(generated.c_str());
+	return failures == 0 ? 0 : 1;
+}
+
+//-- BINARY MESHES --//
+
+// Base.obj -> Base.mbin
+std::string binaryMeshPath(const char* file) {
+	std::string path = file;
+	size_t dot = path.find_last_of('.');
+	if (dot != std::string::npos && path.find_first_of("/\\", dot) == std::string::npos)
+		path.erase(dot);
+	return path + ".mbin";
+}
+
+// Files are written under a name of this process and then renamed over the real one, so a reader
+// (or a viewer that has the old file mapped) never sees it half written
+static std::string tempFilePath(const char* path) {
+	char suffix[32];
+#ifdef _WIN32
+	snprintf(suffix, sizeof(suffix), ".%lu.tmp", (unsigned long)GetCurrentProcessId());
+#else
+	snprintf(suffix, sizeof(suffix), ".%lu.tmp", (unsigned long)getpid());
+#endif
+	return std::string(path) + suffix;
+}
+
+// rename() does not replace an existing file on Windows
+static bool replaceFile(const char* temp, const char* path) {
+#ifdef _WIN32
+	return MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(temp, path) == 0;
+#endif
+}
+
+unsigned long long fnv1a(const void* data, size_t size, unsigned long long hash) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+bool mapFile(const char* file, MappedFile &out) {
+	out.Data = NULL;
+	out.Size = 0;
+#ifdef _WIN32
+	out.File = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (out.File == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	GetFileSizeEx(out.File, &size);
+	out.Size = (size_t)size.QuadPart;
+	out.Mapping = CreateFileMappingA(out.File, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (out.Mapping == NULL) {
+		CloseHandle(out.File);
+		return false;
+	}
+	out.Data = (const unsigned char*)MapViewOfFile(out.Mapping, FILE_MAP_READ, 0, 0, 0);
+	if (out.Data == NULL) {
+		CloseHandle(out.Mapping);
+		CloseHandle(out.File);
+		return false;
+	}
+#else
+	out.File = open(file, O_RDONLY);
+	if (out.File < 0)
+		return false;
+	struct stat info;
+	if (fstat(out.File, &info) != 0 || info.st_size == 0) {
+		close(out.File);
+		return false;
+	}
+	out.Size = (size_t)info.st_size;
+	void* data = mmap(NULL, out.Size, PROT_READ, MAP_PRIVATE, out.File, 0);
+	if (data == MAP_FAILED) {
+		close(out.File);
+		return false;
+	}
+	out.Data = (const unsigned char*)data;
+#endif
+	return true;
+}
+
+void unmapFile(MappedFile &file) {
+	if (file.Data == NULL)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(file.Data);
+	CloseHandle(file.Mapping);
+	CloseHandle(file.File);
+#else
+	munmap((void*)file.Data, file.Size);
+	close(file.File);
+#endif
+	file.Data = NULL;
+}
+
+// Maps the .mbin next to file and stages it into mesh. Returns false if it is missing, stale or corrupt.
+bool readBinaryMesh(const char* file, PreparedMesh &mesh) {
+	std::string path = binaryMeshPath(file);
+	MappedFile mapped;
+	if (!mapFile(path.c_str(), mapped))
+		return false;
+
+	const MeshFileHeader* header = (const MeshFileHeader*)mapped.Data;
+	bool valid = mapped.Size >= sizeof(MeshFileHeader)
+		&& header->Magic == MeshFileMagic
+		&& header->Version == MeshFileVersion
+		&& header->VertexSize == sizeof(PackedVertex)
+		&& header->PositionOffset == offsetof(PackedVertex, Position)
+		&& header->NormalType == GL_INT_2_10_10_10_REV
+		&& header->NormalOffset == offsetof(PackedVertex, Normal)
+		&& header->IndexSize == sizeof(GLushort)
+		&& header->Lods.Count >= 1 && header->Lods.Count <= MaxLods;
+	size_t vertBytes = 0, idxBytes = 0;
+	if (valid) {
+		vertBytes = (size_t)header->NumVertices * sizeof(PackedVertex);
+		idxBytes = (size_t)header->NumIndices * sizeof(GLushort);
+		valid = mapped.Size == sizeof(MeshFileHeader) + vertBytes + idxBytes;
+		for (unsigned int l = 0; l < header->Lods.Count; l++)
+			valid = valid && (size_t)header->Lods.First[l] + header->Lods.Indices[l] <= header->NumIndices;
+	}
+
+	// A binary built from an older .obj is stale; a missing .obj is fine (binary-only install)
+	struct stat source;
+	if (valid && stat(file, &source) == 0
+		&& ((unsigned long long)source.st_size != header->SourceSize || (long long)source.st_mtime != header->SourceTime)) {
+		fprintf(stderr, "%s is stale, loading %s instead\n", path.c_str(), file);
+		unmapFile(mapped);
+		return false;
+	}
+
+	const unsigned char* payload = mapped.Data + sizeof(MeshFileHeader);
+	if (valid && fnv1a(payload, vertBytes + idxBytes, 14695981039346656037ULL) != header->Checksum)
+		valid = false;
+	// The checksum only catches accidents; a crafted file could still index past the vertices
+	const GLushort* idcs = (const GLushort*)(payload + vertBytes);
+	for (unsigned int i = 0; valid && i < header->NumIndices; i++)
+		valid = idcs[i] < header->NumVertices;
+	if (!valid) {
+		fprintf(stderr, "%s is not a valid mesh file, loading %s instead\n", path.c_str(), file);
+		unmapFile(mapped);
+		return false;
+	}
+
+	const PackedVertex* verts = (const PackedVertex*)payload;
+	glm::vec3 quantMin(header->BoundsMin[0], header->BoundsMin[1], header->BoundsMin[2]);
+	glm::vec3 quantMax(header->BoundsMax[0], header->BoundsMax[1], header->BoundsMax[2]);
+	mesh.Lods = header->Lods;
+	mesh.PositionScale = glm::vec4((quantMax - quantMin) / 65535.0f, 0.0f);
+	mesh.PositionBias = glm::vec4(quantMin, 0.0f);
+	measureMesh(verts, header->NumVertices, mesh.PositionScale, mesh.PositionBias, mesh.BoundsMin, mesh.BoundsMax, mesh.Sphere);
+	buildMeshBVH(mesh.BVH, verts, header->NumVertices, idcs, header->Lods.Indices[0], mesh.PositionScale, mesh.PositionBias);
+	buildHull(mesh.BVH.Positions, mesh.Hull);
+	stageMesh(mesh, verts, header->NumVertices, idcs, header->NumIndices);
+
+	unmapFile(mapped);
+	return true;
+}
+
+// Converts one .obj into its indexed, interleaved .mbin form
+bool writeBinaryMesh(const char* file) {
+	struct stat source;
+	if (stat(file, &source) != 0) {
+		fprintf(stderr, "Cannot open %s\n", file);
+		return false;
+	}
+
+	ArenaScope scope(LoadArena);
+	StagingVector<PackedVertex> Verts;
+	StagingVector<GLushort> Idcs;
+	glm::vec3 boundsMin, boundsMax;
+	MeshLods lods;
+	if (!parseObject(file, Verts, Idcs, boundsMin, boundsMax, lods))
+		return false;
+	size_t vertCount = Verts.size(), idxCount = Idcs.size();
+
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.Magic = MeshFileMagic;
+	header.Version = MeshFileVersion;
+	header.VertexSize = sizeof(PackedVertex);
+	header.PositionOffset = offsetof(PackedVertex, Position);
+	header.NormalType = GL_INT_2_10_10_10_REV;
+	header.NormalOffset = offsetof(PackedVertex, Normal);
+	header.IndexSize = sizeof(GLushort);
+	header.NumVertices = (unsigned int)vertCount;
+	header.NumIndices = (unsigned int)idxCount;
+	for (int k = 0; k < 3; k++) {
+		header.BoundsMin[k] = boundsMin[k];
+		header.BoundsMax[k] = boundsMax[k];
+	}
+	header.Lods = lods;
+	header.SourceSize = (unsigned long long)source.st_size;
+	header.SourceTime = (long long)source.st_mtime;
+	header.Checksum = fnv1a(Verts.data(), sizeof(PackedVertex) * vertCount, 14695981039346656037ULL);
+	header.Checksum = fnv1a(Idcs.data(), sizeof(GLushort) * idxCount, header.Checksum);
+
+	// A viewer may have the current .mbin mapped, so it is replaced rather than truncated
+	std::string path = binaryMeshPath(file);
+	std::string tempPath = tempFilePath(path.c_str());
+	FILE* out = fopen(tempPath.c_str(), "wb");
+	bool ok = out != NULL;
+	if (ok) {
+		ok = fwrite(&header, sizeof(header), 1, out) == 1
+			&& fwrite(Verts.data(), sizeof(PackedVertex), vertCount, out) == vertCount
+			&& fwrite(Idcs.data(), sizeof(GLushort), idxCount, out) == idxCount;
+		ok = fclose(out) == 0 && ok;
+		if (!ok || !replaceFile(tempPath.c_str(), path.c_str())) {
+			ok = false;
+			remove(tempPath.c_str());
+		}
+	}
+	if (ok) {
+		printf("%s -> %s (%u vertices, %u indices, triangles per level", file, path.c_str(), header.NumVertices, header.NumIndices);
+		for (unsigned int l = 0; l < lods.Count; l++)
+			printf(" %u", lods.Indices[l] / 3);
+		printf(")\n");
+	}
+	else
+		fprintf(stderr, "Failed to write %s\n", path.c_str());
+	return ok;
+}
+
+// --convert [file.obj ...]: writes a .mbin for each file, or for every scene mesh when none are given
+int convertMeshes(int count, char** files) {
+	const char* sceneMeshes[] = { "Base.obj", "Top.obj", "Arm1.obj", "Joint.obj", "Arm2.obj", "Pen.obj", "Button.obj", "Solid.obj" };
+	if (count == 0) {
+		count = sizeof(sceneMeshes) / sizeof(sceneMeshes[0]);
+		files = (char**)sceneMeshes;
+	}
+	int failed = 0;
+	for (int i = 0; i < count; i++) {
+		if (!writeBinaryMesh(files[i]))
+			failed++;
+	}
+	return failed == 0 ? 0 : 1;
+}
+
+void createObjects(void) {
+	//-- COORDINATE AXES --//
+	CoordVerts[0] = { { 0.0, 0.0, 0.0, 1.0 }, { 1.0, 0.0, 0.0, 1.0 }, { 0.0, 0.0, 1.0 } };
+	CoordVerts[1] = { { 5.0, 0.0, 0.0, 1.0 }, { 1.0, 0.0, 0.0, 1.0 }, { 0.0, 0.0, 1.0 } };
+	CoordVerts[2] = { { 0.0, 0.0, 0.0, 1.0 }, { 0.0, 1.0, 0.0, 1.0 }, { 0.0, 0.0, 1.0 } };
+	CoordVerts[3] = { { 0.0, 5.0, 0.0, 1.0 }, { 0.0, 1.0, 0.0, 1.0 }, { 0.0, 0.0, 1.0 } };
+	CoordVerts[4] = { { 0.0, 0.0, 0.0, 1.0 }, { 0.0, 0.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
+	CoordVerts[5] = { { 0.0, 0.0, 5.0, 1.0 }, { 0.0, 0.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
+	
+	//-- GRID --//
+	
+	for (int i = 0; i < 11; i++)
+	{
+		float xcoord = -5.0 + i;
+		GridVerts[2 * i] = { { xcoord, 0.0, -5.0, 1.0 }, { 1.0, 1.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
+		GridVerts[2 * i + 1] = { { xcoord, 0.0, 5.0, 1.0 }, { 1.0, 1.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
+	}
+	for (int i = 11; i < 22; i++)
+	{
+		float zcoord = -5.0 + (i - 11);
+		GridVerts[2 * i] = { { -5.0, 0.0, zcoord, 1.0 }, { 1.0, 1.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
+		GridVerts[2 * i + 1] = { { 5.0, 0.0, zcoord, 1.0 }, { 1.0, 1.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 } };
+	}
+	
+	//-- .OBJs --//
+
+	// ATTN: Load your models here through .obj files -- example of how to do so is as shown
+	// Meshes are loaded white; their colors come from ObjectColor/HighlightColor at draw time
+
+	//truncated tetrahedron base, red
+	loadMesh("Base.obj", 2, glm::vec4(0.8, 0.0, 0.0, 1.0), glm::vec4(1.0, 0.0, 0.0, 1.0), 'B');
+
+	//ico sphere top, green
+	loadMesh("Top.obj", 3, glm::vec4(0.0, 0.8, 0.0, 1.0), glm::vec4(0.0, 1.0, 0.0, 1.0), 'T');
+
+	//rectangular prism arm1, blue, length 2 * scale
+	loadMesh("Arm1.obj", 4, glm::vec4(0.0, 0.0, 0.8, 1.0), glm::vec4(0.0, 0.0, 1.0, 1.0), '1');
+
+	//dodecahedron joint, purple
+	loadMesh("Joint.obj", 5, glm::vec4(1.0, 0.0, 1.0, 1.0), glm::vec4(1.0, 0.0, 1.0, 1.0), 0);
+
+	//cylinder arm2, cyan, length 2 * scale
+	loadMesh("Arm2.obj", 6, glm::vec4(0.0, 1.0, 1.0, 1.0), glm::vec4(0.8, 1.0, 1.0, 1.0), '2');
+
+	//truncated octahedron pen, yellow
+	loadMesh("Pen.obj", 7, glm::vec4(0.8, 0.8, 0.0, 1.0), glm::vec4(1.0, 1.0, 0.0, 1.0), 'P');
+
+	//cube button, red
+	loadMesh("Button.obj", 8, glm::vec4(1.0, 0.0, 0.0, 1.0), glm::vec4(1.0, 0.0, 0.0, 1.0), 0);
+
+	//solid projectile icosahedron, white
+	loadMesh("Solid.obj", 9, glm::vec4(1.0, 1.0, 1.0, 1.0), glm::vec4(1.0, 1.0, 1.0, 1.0), 0);
+}
+
+// ObjectId draws the mesh already loaded for src
+void shareMesh(int ObjectId, int src) {
+	PickMeshSource[ObjectId] = src;
+	if (src == ObjectId)
+		return;
+	MeshBaseVertex[ObjectId] = MeshBaseVertex[src];
+	MeshFirstIndex[ObjectId] = MeshFirstIndex[src];
+	VertexBufferSize[ObjectId] = VertexBufferSize[src];
+	IndexBufferSize[ObjectId] = IndexBufferSize[src];
+	NumIdcs[ObjectId] = NumIdcs[src];
+	ObjectLods[ObjectId] = ObjectLods[src];
+	PositionScale[ObjectId] = PositionScale[src];
+	PositionBias[ObjectId] = PositionBias[src];
+	MeshBoundsMin[ObjectId] = MeshBoundsMin[src];
+	MeshBoundsMax[ObjectId] = MeshBoundsMax[src];
+	MeshSphere[ObjectId] = MeshSphere[src];
+}
+
+// Registers ObjectId and queues its mesh file for the loader threads. Each file is loaded once;
+// objects drawing a file that is already queued share its mesh when it arrives (see swapInMesh).
+// Until then the object is not resident and is neither drawn nor picked.
+void loadMesh(const char* file, int ObjectId, glm::vec4 color, glm::vec4 highlight, char selectKey) {
+	ObjectColor[ObjectId] = color;
+	HighlightColor[ObjectId] = highlight;
+	ObjectSelectKey[ObjectId] = selectKey;
+	ObjectName[ObjectId] = file;
+	MeshResident[ObjectId] = false;
+
+	std::map<std::string, int>::iterator cached = MeshCache.find(file);
+	if (cached != MeshCache.end()) {
+		PickMeshSource[ObjectId] = cached->second;
+		return;
+	}
+	PickMeshSource[ObjectId] = ObjectId;
+	MeshCache[file] = ObjectId;
+	StreamFiles.push_back(file);
+	MeshesPending++;
+}
+
+//-- HOT RELOAD --//
+
+// Runs on a loader thread or the watcher thread, with that thread's arena. Loaders prefer the
+// precompiled .mbin and fall back to parsing the .obj when it is missing or stale; a reload always
+// parses the .obj that was just saved. The result is staged (see stageMesh), so the arena is free
+// again as soon as the mesh is prepared.
+static PreparedMesh* prepareMesh(const std::string &file, bool binary, LinearArena &arena) {
+	ArenaScope scope(arena);
+	PreparedMesh* mesh = new PreparedMesh;
+	mesh->File = file;
+	if (binary && readBinaryMesh(file.c_str(), *mesh))
+		return mesh;
+	StagingVector<PackedVertex> verts;
+	StagingVector<GLushort> idcs;
+	glm::vec3 quantMin, quantMax;
+	if (!parseObject(file.c_str(), verts, idcs, quantMin, quantMax, mesh->Lods) || verts.empty()) {
+		delete mesh;
+		return NULL;
+	}
+	mesh->PositionScale = glm::vec4((quantMax - quantMin) / 65535.0f, 0.0f);
+	mesh->PositionBias = glm::vec4(quantMin, 0.0f);
+	measureMesh(verts.data(), verts.size(), mesh->PositionScale, mesh->PositionBias, mesh->BoundsMin, mesh->BoundsMax, mesh->Sphere);
+	buildMeshBVH(mesh->BVH, verts.data(), verts.size(), idcs.data(), mesh->Lods.Indices[0], mesh->PositionScale, mesh->PositionBias);
+	buildHull(mesh->BVH.Positions, mesh->Hull);
+	stageMesh(*mesh, verts.data(), verts.size(), idcs.data(), idcs.size());
+	return mesh;
+}
+
+static bool readTextFile(const char* path, std::string &out) {
+	FILE* in = fopen(path, "rb");
+	if (in == NULL)
+		return false;
+	out.clear();
+	char buffer[4096];
+	for (size_t n; (n = fread(buffer, 1, sizeof(buffer), in)) > 0; )
+		out.append(buffer, n);
+	fclose(in);
+	return true;
+}
+
+// A saved file: shader sources are read, meshes prepared, then the result is queued for the render thread
+static void reloadFile(const std::string &name) {
+	if (name == VertexShaderPath || name == FragmentShaderPath) {
+		std::string vertexSource, fragmentSource;
+		if (!readTextFile(VertexShaderPath, vertexSource) || !readTextFile(FragmentShaderPath, fragmentSource))
+			return;
+		std::lock_guard<std::mutex> lock(ReloadMutex);
+		ReadyVertexSource.swap(vertexSource);
+		ReadyFragmentSource.swap(fragmentSource);
+		ReadyShaders = true;
+		return;
+	}
+	if (MeshCache.find(name) == MeshCache.end())
+		return;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	PreparedMesh* mesh = prepareMesh(name, false, ReloadArena);
+	if (mesh == NULL) {
+		fprintf(stderr, "Reloading %s failed, keeping the loaded mesh\n", name.c_str());
+		return;
+	}
+	printf("Prepared %s in %.1f ms\n", name.c_str(), std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	std::lock_guard<std::mutex> lock(ReloadMutex);
+	ReadyMeshes.push_back(mesh);
+}
+
+// Watches the working directory: inotify on Linux, modification times polled four times a second elsewhere
+static void reloadMain(void) {
+#ifdef __linux__
+	int watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch < 0 || inotify_add_watch(watch, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		fprintf(stderr, "Hot reload disabled: cannot watch the working directory\n");
+		if (watch >= 0)
+			close(watch);
+		return;
+	}
+	alignas(struct inotify_event) char buffer[4096];
+	while (!ReloadQuit.load()) {
+		struct pollfd fd = { watch, POLLIN, 0 };
+		if (poll(&fd, 1, 100) <= 0)
+			continue;
+		// Editors often write a file in several steps; handle each name once per batch of events
+		std::vector<std::string> changed;
+		for (ssize_t length; (length = read(watch, buffer, sizeof(buffer))) > 0; ) {
+			for (char* p = buffer; p < buffer + length; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len) {
+				const struct inotify_event* event = (const struct inotify_event*)p;
+				if (event->len > 0 && std::find(changed.begin(), changed.end(), event->name) == changed.end())
+					changed.push_back(event->name);
+			}
+		}
+		for (size_t i = 0; i < changed.size(); i++)
+			reloadFile(changed[i]);
+	}
+	close(watch);
+#else
+	std::vector<std::string> files;
+	files.push_back(VertexShaderPath);
+	files.push_back(FragmentShaderPath);
+	for (std::map<std::string, int>::iterator it = MeshCache.begin(); it != MeshCache.end(); ++it)
+		files.push_back(it->first);
+	std::vector<long long> times(files.size(), 0);
+	for (size_t i = 0; i < files.size(); i++) {
+		struct stat info;
+		if (stat(files[i].c_str(), &info) == 0)
+			times[i] = (long long)info.st_mtime;
+	}
+	while (!ReloadQuit.load()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		for (size_t i = 0; i < files.size(); i++) {
+			struct stat info;
+			if (stat(files[i].c_str(), &info) != 0 || (long long)info.st_mtime == times[i])
+				continue;
+			times[i] = (long long)info.st_mtime;
+			reloadFile(files[i]);
+		}
+	}
+#endif
+	arenaRelease(ReloadArena);
+}
+
+void startHotReload(void) {
+	if (GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	else
+		printf("No KHR_parallel_shader_compile: shader reloads compile on the render thread and can hitch a frame\n");
+	ReloadQuit = false;
+	ReloadThread = std::thread(reloadMain);
+}
+
+void stopHotReload(void) {
+	if (!ReloadThread.joinable())
+		return;
+	ReloadQuit = true;
+	ReloadThread.join();	// meshes it left in ReadyMeshes are freed by stopStreaming()
+}
+
+// Starts compiling and linking a program; with KHR_parallel_shader_compile this returns right away
+static GLuint compileProgram(const std::string &vertexSource, const std::string &fragmentSource) {
+	GLuint program = glCreateProgram();
+	const std::string* sources[2] = { &vertexSource, &fragmentSource };
+	GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	for (int k = 0; k < 2; k++) {
+		GLuint shader = glCreateShader(types[k]);
+		const char* text = sources[k]->c_str();
+		glShaderSource(shader, 1, &text, NULL);
+		glCompileShader(shader);
+		glAttachShader(program, shader);
+		glDeleteShader(shader);	// freed with the program
+	}
+	if (GLEW_ARB_get_program_binary)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+	return program;
+}
+
+// Compile log of a program's shaders, or else its link log
+static void programLog(GLuint program, char* log, GLsizei size) {
+	log[0] = 0;
+	GLuint shaders[2];
+	GLsizei count = 0;
+	glGetAttachedShaders(program, 2, &count, shaders);
+	for (int k = 0; k < count && log[0] == 0; k++)
+		glGetShaderInfoLog(shaders[k], size, NULL, log);
+	if (log[0] == 0)
+		glGetProgramInfoLog(program, size, NULL, log);
+}
+
+static bool programCacheSupported(void) {
+	if (!UseProgramCache || !GLEW_ARB_get_program_binary)
+		return false;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+static unsigned long long programKey(const std::string &vertexSource, const std::string &fragmentSource) {
+	const char* driver[3] = { (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION) };
+	unsigned long long key = 14695981039346656037ULL;
+	// Each string is hashed with its length so no two sets of strings run together the same way
+	const std::string* sources[2] = { &vertexSource, &fragmentSource };
+	for (int k = 0; k < 2; k++) {
+		size_t length = sources[k]->size();
+		key = fnv1a(&length, sizeof(length), key);
+		key = fnv1a(sources[k]->data(), length, key);
+	}
+	for (int k = 0; k < 3; k++) {
+		size_t length = driver[k] != NULL ? strlen(driver[k]) : 0;
+		key = fnv1a(&length, sizeof(length), key);
+		key = fnv1a(driver[k], length, key);
+	}
+	return key;
+}
+
+// The cached program for key, or 0 when there is none or the driver rejects it
+static GLuint loadCachedProgram(unsigned long long key) {
+	FILE* in = fopen(ProgramCachePath, "rb");
+	if (in == NULL)
+		return 0;
+	ProgramCacheHeader header;
+	std::vector<char> binary;
+	bool ok = fread(&header, sizeof(header), 1, in) == 1 && memcmp(header.Magic, "MVPB", 4) == 0 && header.Key == key && header.Length > 0;
+	// A truncated or garbage file must not size the allocation; anything but an exact fit is a miss
+	struct stat info;
+	if (ok)
+		ok = stat(ProgramCachePath, &info) == 0 && (unsigned long long)info.st_size == sizeof(header) + (unsigned long long)header.Length;
+	if (ok) {
+		binary.resize(header.Length);
+		ok = fread(&binary[0], 1, binary.size(), in) == binary.size();
+	}
+	fclose(in);
+	if (!ok)
+		return 0;
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.Format, &binary[0], header.Length);
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		fprintf(stderr, "Driver rejected %s, compiling shaders from source\n", ProgramCachePath);
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+static void saveProgramBinary(GLuint program, unsigned long long key) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, &binary[0]);
+	ProgramCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, "MVPB", 4);
+	header.Format = format;
+	header.Key = key;
+	header.Length = (unsigned int)length;
+
+	// Two viewers saving at once never leave a torn file
+	std::string tempPath = tempFilePath(ProgramCachePath);
+	FILE* out = fopen(tempPath.c_str(), "wb");
+	if (out == NULL) {
+		fprintf(stderr, "Cannot write %s\n", tempPath.c_str());
+		return;
+	}
+	fwrite(&header, sizeof(header), 1, out);
+	fwrite(&binary[0], 1, length, out);
+	bool ok = ferror(out) == 0;
+	ok = fclose(out) == 0 && ok;
+	if (!ok || !replaceFile(tempPath.c_str(), ProgramCachePath)) {
+		fprintf(stderr, "Cannot write %s\n", ProgramCachePath);
+		remove(tempPath.c_str());
+	}
+}
+
+// Builds the StandardShading program at startup, from the binary cache when it holds these exact
+// sources for this driver and from source otherwise, and reports how long that took
+GLuint loadProgram(void) {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::string vertexSource, fragmentSource;
+	if (!readTextFile(VertexShaderPath, vertexSource) || !readTextFile(FragmentShaderPath, fragmentSource)) {
+		fprintf(stderr, "Cannot read %s or %s\n", VertexShaderPath, FragmentShaderPath);
+		return 0;
+	}
+	bool cache = programCacheSupported();
+	unsigned long long key = cache ? programKey(vertexSource, fragmentSource) : 0;
+	GLuint program = cache ? loadCachedProgram(key) : 0;
+	bool cached = program != 0;
+	GLint linked = GL_TRUE;
+	if (!cached) {
+		program = compileProgram(vertexSource, fragmentSource);
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);	// waits for a parallel compile
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	if (!linked) {
+		char log[4096];
+		programLog(program, log, sizeof(log));
+		fprintf(stderr, "Shader program failed to build:\n%s\n", log);
+	}
+	else if (!cached && cache) {
+		saveProgramBinary(program, key);
+	}
+	printf("Shader program %s in %.1f ms\n", cached ? "loaded from the binary cache" : "compiled from source", ms);
+	return program;
+}
+
+// Swaps in PendingProgram once the driver is done with it; a program that fails to link is reported
+// and dropped, and the current one stays in use
+static void finishPendingProgram(void) {
+	GLint done = GL_TRUE;
+	if (GLEW_KHR_parallel_shader_compile)
+		glGetProgramiv(PendingProgram, GL_COMPLETION_STATUS_KHR, &done);
+	if (!done)
+		return;
+	GLint linked = GL_FALSE;
+	glGetProgramiv(PendingProgram, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		char log[4096];
+		programLog(PendingProgram, log, sizeof(log));
+		fprintf(stderr, "Shader reload failed, keeping the current program:\n%s\n", log);
+		glDeleteProgram(PendingProgram);
+	}
+	else {
+		glDeleteProgram(programID);
+		programID = PendingProgram;
+		setupProgram(programID);
+		SceneGeneration++;
+		if (programCacheSupported())
+			saveProgramBinary(programID, PendingProgramKey);
+		printf("Shaders reloaded\n");
+	}
+	PendingProgram = 0;
+}
+
+// Makes a prepared mesh resident, in place of the loaded one if there is one, for every object that
+// draws it. A reload is written over the mesh's old arena range when it fits, otherwise the old range is freed.
+static void swapInMesh(PreparedMesh &mesh) {
+	int src = MeshCache[mesh.File];
+	bool reload = MeshResident[src];
+	VertexBufferSize[src] = sizeof(PackedVertex) * mesh.NumVertices;
+	IndexBufferSize[src] = sizeof(GLushort) * mesh.NumIndices;
+	if (mesh.InRing)
+		copyMeshArena(mesh.RingOffset, src);
+	else
+		appendMeshArena(mesh.Vertices.data(), mesh.Indices.data(), src);
+	ObjectLods[src] = mesh.Lods;
+	NumIdcs[src] = mesh.Lods.Indices[0];
+	PositionScale[src] = mesh.PositionScale;
+	PositionBias[src] = mesh.PositionBias;
+	MeshBoundsMin[src] = mesh.BoundsMin;
+	MeshBoundsMax[src] = mesh.BoundsMax;
+	std::swap(PickMeshes[src], mesh.BVH);
+	{
+		// Self collision reads the spheres, hulls and PickMeshSource on the simulation thread
+		std::lock_guard<std::mutex> lock(SimInputMutex);
+		MeshSphere[src] = mesh.Sphere;
+		std::swap(CollisionHulls[src], mesh.Hull);
+		CollisionPairsValid = false;
+		for (int ObjectId = 0; ObjectId < NumObjects; ObjectId++) {
+			if (ObjectName[ObjectId] != mesh.File)
+				continue;
+			if (ObjectId != src)
+				shareMesh(ObjectId, src);
+			MeshResident[ObjectId] = true;
+		}
+	}
+	SceneGeneration++;
+	if (reload) {
+		printf("Reloaded %s\n", mesh.File.c_str());
+		return;
+	}
+	if (--MeshesPending == 0) {
+		printf("All %d meshes resident after %.1f ms\n", (int)StreamFiles.size(),
+			std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - StreamStart).count());
+		printf("Mesh vertex buffers: %d vertices, %d bytes (%d bytes with the float Vertex layout)\n", (int)MeshVertexCount,
+			(int)(MeshVertexCount * sizeof(PackedVertex)), (int)(MeshVertexCount * sizeof(Vertex)));
+	}
+}
+
+// Called by the render thread between frames. Never blocks: if a loader or the watcher is publishing
+// a result right now, it is picked up next frame. The one exception is a shader reload on a driver
+// without KHR_parallel_shader_compile, which compiles here and is logged.
+void applyReloads(void) {
+	retireStagingRing();
+	if (PendingProgram != 0)
+		finishPendingProgram();
+	std::vector<PreparedMesh*> meshes;
+	std::string vertexSource, fragmentSource;
+	bool shaders = false;
+	{
+		std::unique_lock<std::mutex> lock(ReloadMutex, std::try_to_lock);
+		if (!lock.owns_lock())
+			return;
+		meshes.swap(ReadyMeshes);
+		if (ReadyShaders) {
+			vertexSource.swap(ReadyVertexSource);
+			fragmentSource.swap(ReadyFragmentSource);
+			ReadyShaders = false;
+			shaders = true;
+		}
+	}
+	for (size_t i = 0; i < meshes.size(); i++) {
+		swapInMesh(*meshes[i]);
+		delete meshes[i];
+	}
+	if (shaders) {
+		if (PendingProgram != 0)
+			glDeleteProgram(PendingProgram);
+		auto start = std::chrono::high_resolution_clock::now();
+		PendingProgram = compileProgram(vertexSource, fragmentSource);
+		PendingProgramKey = programCacheSupported() ? programKey(vertexSource, fragmentSource) : 0;
+		// Without the extension the compile and link above ran on this thread, inside the frame
+		if (!GLEW_KHR_parallel_shader_compile) {
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			printf("Shader reload blocked the render thread for %.1f ms\n", ms);
+		}
+	}
+}
+
+//-- ASSET STREAMING --//
+
+// Persistently mapped ring the loaders write meshes into. Without ARB_buffer_storage there is no
+// ring and stageMesh keeps meshes in client memory.
+void createStagingRing(void) {
+	if (!GLEW_ARB_buffer_storage) {
+		printf("Meshes staged in client memory and uploaded with glBufferSubData\n");
+		return;
+	}
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &StagingRingBuffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, StagingRingBuffer);
+	glBufferStorage(GL_COPY_READ_BUFFER, StagingRingSize, NULL, flags);
+	StagingRingData = (unsigned char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, StagingRingSize, flags);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	printf("Meshes staged through a %d KB persistently mapped ring\n", (int)(StagingRingSize >> 10));
+}
+
+// Reserves bytes of the ring, waiting for the GPU to retire older copies while it is full. Returns
+// false without a ring, for a mesh larger than the ring, or while loading is being shut down.
+static bool allocStagingRing(size_t bytes, size_t &offset) {
+	if (StagingRingData == NULL || bytes > StagingRingSize)
+		return false;
+	std::unique_lock<std::mutex> lock(StagingRingMutex);
+	for (;;) {
+		if (StagingRanges.empty())
+			StagingRingHead = 0;
+		// A range never wraps; the bytes skipped at the end of the ring are retired with it
+		size_t skip = StagingRingHead + bytes > StagingRingSize ? StagingRingSize - StagingRingHead : 0;
+		if (StagingRingUsed + skip + bytes <= StagingRingSize) {
+			offset = skip > 0 ? 0 : StagingRingHead;
+			StagingRange range = { offset, skip + bytes, false };
+			StagingRanges.push_back(range);
+			StagingRingUsed += skip + bytes;
+			StagingRingHead = (offset + bytes) % StagingRingSize;
+			return true;
+		}
+		if (StreamQuit.load() || ReloadQuit.load())
+			return false;
+		// Woken by retireStagingRing(); the timeout notices shutdown
+		StagingRingSpace.wait_for(lock, std::chrono::milliseconds(50));
+	}
+}
+
+// Copies a decoded mesh to where the render thread uploads it from: the ring when there is room,
+// client memory otherwise
+void stageMesh(PreparedMesh &mesh, const PackedVertex* verts, size_t vertCount, const GLushort* idcs, size_t idxCount) {
+	size_t vertBytes = sizeof(PackedVertex) * vertCount, idxBytes = sizeof(GLushort) * idxCount;
+	mesh.NumVertices = vertCount;
+	mesh.NumIndices = idxCount;
+	mesh.InRing = allocStagingRing((vertBytes + idxBytes + StagingAlignment - 1) & ~(StagingAlignment - 1), mesh.RingOffset);
+	if (mesh.InRing) {
+		memcpy(StagingRingData + mesh.RingOffset, verts, vertBytes);
+		memcpy(StagingRingData + mesh.RingOffset + vertBytes, idcs, idxBytes);
+		return;
+	}
+	mesh.Vertices.assign(verts, verts + vertCount);
+	mesh.Indices.assign(idcs, idcs + idxCount);
+}
+
+// Frees the ring ranges whose copies the GPU has finished. Ranges retire in any order but are only
+// reused from the oldest one on, so the free space stays contiguous.
+void retireStagingRing(void) {
+	bool retired = false;
+	while (!StagingFences.empty()) {
+		StagingFence &fence = StagingFences.front();
+		GLenum state = glClientWaitSync(fence.Sync, 0, 0);
+		if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+			break;
+		glDeleteSync(fence.Sync);
+		std::lock_guard<std::mutex> lock(StagingRingMutex);
+		for (size_t i = 0; i < StagingRanges.size(); i++)
+			if (StagingRanges[i].Offset == fence.Offset)
+				StagingRanges[i].Retired = true;
+		while (!StagingRanges.empty() && StagingRanges.front().Retired) {
+			StagingRingUsed -= StagingRanges.front().Bytes;
+			StagingRanges.pop_front();
+		}
+		StagingFences.pop_front();
+		retired = true;
+	}
+	if (retired)
+		StagingRingSpace.notify_all();
+}
+
+// Loader thread: prepares queued files until none are left
+static void streamMain(void) {
+	LinearArena arena = {};
+	for (;;) {
+		int next = NextStreamFile++;
+		if (next >= (int)StreamFiles.size() || StreamQuit.load())
+			break;
+		PreparedMesh* mesh = prepareMesh(StreamFiles[next], true, arena);
+		if (mesh == NULL) {
+			fprintf(stderr, "Cannot load %s\n", StreamFiles[next].c_str());
+			MeshesPending--;
+			continue;
+		}
+		std::lock_guard<std::mutex> lock(ReloadMutex);
+		ReadyMeshes.push_back(mesh);
+	}
+	arenaRelease(arena);
+}
+
+void startStreaming(void) {
+	int threads = std::min(std::min((int)StreamFiles.size(), MaxStreamThreads), (int)std::max(1u, std::thread::hardware_concurrency()));
+	StreamQuit = false;
+	NextStreamFile = 0;
+	for (int i = 0; i < threads; i++)
+		StreamThreads.push_back(std::thread(streamMain));
+}
+
+// Makes every queued mesh resident before returning, for runs whose frames must not depend on
+// how fast the meshes happened to load
+void finishStreaming(void) {
+	while (MeshesPending.load() > 0) {
+		applyReloads();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+// Joins the loaders and frees prepared meshes nobody picked up; call after stopHotReload()
+void stopStreaming(void) {
+	StreamQuit = true;
+	for (size_t i = 0; i < StreamThreads.size(); i++)
+		StreamThreads[i].join();
+	StreamThreads.clear();
+	std::lock_guard<std::mutex> lock(ReloadMutex);
+	for (size_t i = 0; i < ReadyMeshes.size(); i++)
+		delete ReadyMeshes[i];
+	ReadyMeshes.clear();
+}
+
+// Draw color of ObjectId, highlighted when it is the current selection
+glm::vec4 objectColor(int ObjectId) {
+	if (ObjectSelectKey[ObjectId] != 0 && ObjectSelectKey[ObjectId] == selection)
+		return HighlightColor[ObjectId];
+	return ObjectColor[ObjectId];
+}
+
+//-- UNIFORM BUFFERS --//
+
+// Reserves the next ObjectBlock entry of list's frame, drawing ObjectId's vertices, and returns its index
+int addDrawSlot(RenderList &list, const glm::mat4 &model, const glm::vec4 &color, int ObjectId) {
+	if (list.NumSlots >= MaxDrawSlots) {
+		fprintf(stderr, "Out of draw slots, raise MaxDrawSlots\n");
+		return MaxDrawSlots - 1;
+	}
+	ObjectUniforms &slot = list.Slots[list.NumSlots];
+	slot.Model = model;
+	slot.Color = color;
+	slot.PositionScale = PositionScale[ObjectId];
+	slot.PositionBias = PositionBias[ObjectId];
+	return list.NumSlots++;
+}
+
+// Uploads FrameData and the used draw slots, skipping either buffer when nothing changed since the last frame
+void uploadFrameUniforms(void) {
+	if (memcmp(&FrameData, &UploadedFrameData, sizeof(FrameData)) != 0) {
+		GL_COUNTED(glBindBuffer(GL_UNIFORM_BUFFER, FrameUniformBufferId));
+		GL_COUNTED(glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &FrameData));
+		UploadedFrameData = FrameData;
+	}
+	if (NumDrawSlots != NumUploadedDrawSlots || memcmp(DrawSlots, UploadedDrawSlots, sizeof(ObjectUniforms) * NumDrawSlots) != 0) {
+		// Orphan the old storage so the driver does not wait for the previous frame's draws
+		GL_COUNTED(glBindBuffer(GL_UNIFORM_BUFFER, ObjectUniformBufferId));
+		GL_COUNTED(glBufferData(GL_UNIFORM_BUFFER, sizeof(DrawSlots), NULL, GL_STREAM_DRAW));
+		GL_COUNTED(glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ObjectUniforms) * NumDrawSlots, DrawSlots));
+		memcpy(UploadedDrawSlots, DrawSlots, sizeof(ObjectUniforms) * NumDrawSlots);
+		NumUploadedDrawSlots = NumDrawSlots;
+	}
+}
+
+// Selects the ObjectBlock entry for the next draw, skipping the upload if it is already current
+void setObjectIndex(int slot) {
+	if (slot == CurrentObjectIndex)
+		return;
+	GL_COUNTED(glUniform1i(ObjectIndexID, slot));
+	CurrentObjectIndex = slot;
+}
+
+//-- TRANSFORM HIERARCHY --//
+
+// Appends a node below parent (-1 for a root); parents must be added before their children
+int addNode(int parent, int ObjectId) {
+	int node = (int)NodeParent.size();
+	NodeParent.push_back(parent);
+	NodeObject.push_back(ObjectId);
+	NodeLocal.push_back(glm::mat4(1.0));
+	NodeWorld.push_back(glm::mat4(1.0));
+	NodeDirty.push_back(1);
+	NodeParams.push_back(glm::vec3(NAN, NAN, NAN));
+	NodeLod.push_back(0);
+	return node;
+}
+
+void createHierarchy(void) {
+	float scale = 1.0f;
+	addNode(-1, -1);	// NODE_ROOT
+	addNode(NODE_ROOT, 2);	// NODE_BASE
+	addNode(NODE_BASE, 3);	// NODE_TOP
+	addNode(NODE_TOP, 4);	// NODE_ARM1
+	addNode(NODE_ARM1, 5);	// NODE_JOINT
+	addNode(NODE_JOINT, 6);	// NODE_ARM2
+	addNode(NODE_ARM2, 7);	// NODE_PEN
+	addNode(NODE_PEN, 8);	// NODE_BUTTON
+	addNode(NODE_PEN, -1);	// NODE_SOLID, where projectiles are spawned
+
+	// Fixed offsets never change after this
+	NodeLocal[NODE_ROOT] = glm::scale(glm::mat4(1.0), glm::vec3(scale, scale, scale));
+	NodeLocal[NODE_JOINT] = glm::translate(glm::mat4(1.0), glm::vec3(0.0f, 2.0, 0.0f));
+	NodeLocal[NODE_BUTTON] = glm::translate(glm::mat4(1.0), glm::vec3(-0.2f, 0.6, 0.0f));
+	NodeLocal[NODE_SOLID] = glm::translate(glm::mat4(1.0), glm::vec3(0.0f, -0.4f, 0.0f));
+}
+
+// Snapshot of the joint globals; callers on other threads must hold SimInputMutex
+JointState currentJoints(void) {
+	JointState joints;
+	joints.trans_base_x = trans_base_x;
+	joints.trans_base_z = trans_base_z;
+	joints.rot_top = rot_top;
+	joints.rot_arm1 = rot_arm1;
+	joints.rot_arm2 = rot_arm2;
+	joints.rot_pen_long = rot_pen_long;
+	joints.rot_pen_lat = rot_pen_lat;
+	joints.rot_pen_twist = rot_pen_twist;
+	return joints;
+}
+
+// Writes joints back to the globals; same locking rule as currentJoints()
+void setJoints(const JointState &joints) {
+	trans_base_x = joints.trans_base_x;
+	trans_base_z = joints.trans_base_z;
+	rot_top = joints.rot_top;
+	rot_arm1 = joints.rot_arm1;
+	rot_arm2 = joints.rot_arm2;
+	rot_pen_long = joints.rot_pen_long;
+	rot_pen_lat = joints.rot_pen_lat;
+	rot_pen_twist = joints.rot_pen_twist;
+}
+
+// Local matrix of a node for the given joint values; fixed nodes return their constant offset
+glm::mat4 jointLocalMatrix(int node, const JointState &joints) {
+	glm::vec3 xRotationAxis(1.0f, 0.0f, 0.0f);
+	glm::vec3 yRotationAxis(0.0f, 1.0f, 0.0f);
+	glm::vec3 zRotationAxis(0.0f, 0.0f, 1.0f);
+	glm::mat4 local(1.0);
+	switch (node)
+	{
+	case NODE_BASE:
+		local = glm::translate(local, glm::vec3(joints.trans_base_x, 0.0f, joints.trans_base_z));
+		break;
+	case NODE_TOP:
+		local = glm::rotate(local, joints.rot_top, yRotationAxis);
+		local = glm::translate(local, glm::vec3(0.0f, 1.6, 0.0f));
+		break;
+	case NODE_ARM1:
+		local = glm::rotate(local, joints.rot_arm1, zRotationAxis);
+		break;
+	case NODE_ARM2:
+		local = glm::rotate(local, joints.rot_arm2, zRotationAxis);
+		break;
+	case NODE_PEN:
+		local = glm::translate(local, glm::vec3(0.0f, 1.8f, 0.0f));
+		local = glm::rotate(local, joints.rot_pen_long, xRotationAxis);
+		local = glm::rotate(local, joints.rot_pen_lat, zRotationAxis);
+		local = glm::rotate(local, joints.rot_pen_twist, yRotationAxis);
+		break;
+	default:
+		local = NodeLocal[node];
+		break;
+	}
+	return local;
+}
+
+// World matrix of a node computed from scratch, for threads that cannot use the cached hierarchy
+glm::mat4 nodeMatrixFromState(int node, const JointState &joints) {
+	glm::mat4 world = jointLocalMatrix(node, joints);
+	for (int parent = NodeParent[node]; parent >= 0; parent = NodeParent[parent])
+		world = jointLocalMatrix(parent, joints) * world;
+	return world;
+}
+
+// Rebuilds the local matrix of each joint whose driving values changed and marks it dirty
+void syncJointTransforms(const JointState &joints) {
+	glm::vec3 params[NODE_SOLID + 1];
+	params[NODE_BASE] = glm::vec3(joints.trans_base_x, joints.trans_base_z, 0.0f);
+	params[NODE_TOP] = glm::vec3(joints.rot_top, 0.0f, 0.0f);
+	params[NODE_ARM1] = glm::vec3(joints.rot_arm1, 0.0f, 0.0f);
+	params[NODE_ARM2] = glm::vec3(joints.rot_arm2, 0.0f, 0.0f);
+	params[NODE_PEN] = glm::vec3(joints.rot_pen_long, joints.rot_pen_lat, joints.rot_pen_twist);
+	const int jointNodes[] = { NODE_BASE, NODE_TOP, NODE_ARM1, NODE_ARM2, NODE_PEN };
+
+	for (int j = 0; j < 5; j++) {
+		int node = jointNodes[j];
+		if (params[node] == NodeParams[node])
+			continue;
+		NodeParams[node] = params[node];
+		NodeDirty[node] = 1;
+		NodeLocal[node] = jointLocalMatrix(node, joints);
+	}
+}
+
+// One forward pass; dirtiness flows from parents to children, clean subtrees are skipped
+void updateWorldTransforms(void) {
+	size_t count = NodeParent.size();
+	for (size_t i = 0; i < count; i++) {
+		int parent = NodeParent[i];
+		if (parent >= 0 && NodeDirty[parent])
+			NodeDirty[i] = 1;
+		if (!NodeDirty[i])
+			continue;
+		NodeWorld[i] = parent >= 0 ? NodeWorld[parent] * NodeLocal[i] : NodeLocal[i];
+	}
+	for (size_t i = 0; i < count; i++)
+		NodeDirty[i] = 0;
+}
+
+//-- INVERSE KINEMATICS --//
+
+// Pen tip in world space and its derivatives by top, arm1, arm2, pen long and pen lat (columns of
+// jac), from the sines and cosines of top, arm1, arm1 + arm2, pen long and pen lat. Same chain as
+// jointLocalMatrix(): arm1 and arm2 turn about z in the frame of the top, the pen turns about x
+// then z, and the top turns the whole plane about y.
+static inline void ikChainTrig(float st, float ct, float s1, float c1, float s12, float c12, float sl, float cl, float sp, float cp,
+	float baseX, float baseZ, float tip[3], float jac[3][5]) {
+	// Tip relative to the pen origin after the pen rotations, then in the frame of the top
+	float u = IKPenTip * sp, v = -IKPenTip * cp * cl, w = -IKPenTip * cp * sl;
+	float lx = -IKArm1Length * s1 - IKArm2Length * s12 + u * c12 - v * s12;
+	float ly = IKArm1Length * c1 + IKArm2Length * c12 + u * s12 + v * c12;
+	float lz = w;
+	tip[0] = baseX + lx * ct + lz * st;
+	tip[1] = IKTopHeight + ly;
+	tip[2] = baseZ - lx * st + lz * ct;
+
+	// Derivatives in the frame of the top; arm1 moves everything arm2 moves, plus the joint
+	float d[5][3];
+	d[2][0] = -IKArm2Length * c12 - u * s12 - v * c12;
+	d[2][1] = -IKArm2Length * s12 + u * c12 - v * s12;
+	d[2][2] = 0.0f;
+	d[1][0] = d[2][0] - IKArm1Length * c1;
+	d[1][1] = d[2][1] - IKArm1Length * s1;
+	d[1][2] = 0.0f;
+	float dvLong = IKPenTip * cp * sl, dwLong = -IKPenTip * cp * cl;
+	d[3][0] = -dvLong * s12;
+	d[3][1] = dvLong * c12;
+	d[3][2] = dwLong;
+	float duLat = IKPenTip * cp, dvLat = IKPenTip * sp * cl, dwLat = IKPenTip * sp * sl;
+	d[4][0] = duLat * c12 - dvLat * s12;
+	d[4][1] = duLat * s12 + dvLat * c12;
+	d[4][2] = dwLat;
+	jac[0][0] = -lx * st + lz * ct;
+	jac[1][0] = 0.0f;
+	jac[2][0] = -lx * ct - lz * st;
+	for (int k = 1; k < 5; k++) {
+		jac[0][k] = d[k][0] * ct + d[k][2] * st;
+		jac[1][k] = d[k][1];
+		jac[2][k] = -d[k][0] * st + d[k][2] * ct;
+	}
+}
+
+static inline void ikChain(float top, float arm1, float arm2, float penLong, float penLat, float baseX, float baseZ, float tip[3], float jac[3][5]) {
+	ikChainTrig(sinf(top), cosf(top), sinf(arm1), cosf(arm1), sinf(arm1 + arm2), cosf(arm1 + arm2), sinf(penLong), cosf(penLong),
+		sinf(penLat), cosf(penLat), baseX, baseZ, tip, jac);
+}
+
+void resizeIKBatch(IKBatch &batch, int count) {
+	batch.Count = count;
+	std::vector<float>* columns[] = { &batch.TargetX, &batch.TargetY, &batch.TargetZ, &batch.Top, &batch.Arm1, &batch.Arm2,
+		&batch.PenLong, &batch.PenLat, &batch.Error };
+	for (int c = 0; c < 9; c++)
+		columns[c]->resize(count);
+	batch.Iterations.resize(count);
+}
+
+// Sine and cosine of one iteration's joint change (at most 2 * IKMaxStep) as polynomials, so the
+// step loop needs no library calls
+static inline void ikStepSinCos(float x, float &s, float &c) {
+	float x2 = x * x;
+	s = x * (1.0f - x2 * (1.0f / 6.0f) * (1.0f - x2 * (1.0f / 20.0f) * (1.0f - x2 * (1.0f / 42.0f) * (1.0f - x2 * (1.0f / 72.0f)))));
+	c = 1.0f - x2 * 0.5f * (1.0f - x2 * (1.0f / 12.0f) * (1.0f - x2 * (1.0f / 30.0f) * (1.0f - x2 * (1.0f / 56.0f))));
+}
+
+// Damped least squares, dq = J^T (J J^T + lambda^2 I)^-1 e, scaled down so no joint moves more
+// than IKMaxStep, with arm1 kept inside its limits. Targets stream through a fixed set of lanes: a
+// lane that converges (or runs out of iterations) is written back and refilled with the next
+// target, so every step works on full lanes. Sines and cosines are taken once per target and then
+// rotated along with the joints; the step loop is branch free (lanes that are done get a zero
+// step), which lets the compiler run it several lanes at a time.
+static void solveIKLanes(IKBatch &batch, float baseX, float baseZ, int lanes) {
+	int target[IKBlock];	// batch index in each lane, -1 when idle
+	float q[5][IKBlock], sines[5][IKBlock], cosines[5][IKBlock];	// top, arm1, arm2, pen long, pen lat
+	float tx[IKBlock], ty[IKBlock], tz[IKBlock];
+	float live[IKBlock];	// 1 while the lane is moving
+	int iterations[IKBlock];
+	memset(q, 0, sizeof(q));
+	memset(sines, 0, sizeof(sines));
+	memset(cosines, 0, sizeof(cosines));
+	for (int i = 0; i < lanes; i++) {
+		target[i] = -1;
+		tx[i] = ty[i] = tz[i] = live[i] = 0.0f;
+		iterations[i] = 0;
+	}
+
+	const float damping2 = IKDamping * IKDamping;
+	const float tolerance2 = IKTolerance * IKTolerance;
+	int next = 0;
+	for (;;) {
+		int busy = 0;
+		for (int i = 0; i < lanes; i++) {
+			if (live[i] != 0.0f) {
+				busy++;
+				continue;
+			}
+			if (target[i] >= 0) {
+				int t = target[i];
+				float tip[3], jac[3][5];
+				ikChain(q[0][i], q[1][i], q[2][i], q[3][i], q[4][i], baseX, baseZ, tip, jac);
+				batch.Top[t] = q[0][i];
+				batch.Arm1[t] = q[1][i];
+				batch.Arm2[t] = q[2][i];
+				batch.PenLong[t] = q[3][i];
+				batch.PenLat[t] = q[4][i];
+				batch.Error[t] = glm::length(glm::vec3(tx[i] - tip[0], ty[i] - tip[1], tz[i] - tip[2]));
+				batch.Iterations[t] = iterations[i];
+				target[i] = -1;
+			}
+			if (next == batch.Count)
+				continue;
+			int t = target[i] = next++;
+			q[0][i] = batch.Top[t];
+			q[1][i] = std::max(-Arm1Limit, std::min(Arm1Limit, batch.Arm1[t]));
+			q[2][i] = batch.Arm2[t];
+			q[3][i] = batch.PenLong[t];
+			q[4][i] = batch.PenLat[t];
+			float angles[5] = { q[0][i], q[1][i], q[1][i] + q[2][i], q[3][i], q[4][i] };
+			for (int k = 0; k < 5; k++) {
+				sines[k][i] = sinf(angles[k]);
+				cosines[k][i] = cosf(angles[k]);
+			}
+			tx[i] = batch.TargetX[t];
+			ty[i] = batch.TargetY[t];
+			tz[i] = batch.TargetZ[t];
+			iterations[i] = 0;
+			live[i] = 1.0f;
+			busy++;
+		}
+		if (busy == 0)
+			break;
+
+		for (int i = 0; i < lanes; i++) {
+			float tip[3], jac[3][5];
+			ikChainTrig(sines[0][i], cosines[0][i], sines[1][i], cosines[1][i], sines[2][i], cosines[2][i],
+				sines[3][i], cosines[3][i], sines[4][i], cosines[4][i], baseX, baseZ, tip, jac);
+			float e[3] = { tx[i] - tip[0], ty[i] - tip[1], tz[i] - tip[2] };
+			live[i] *= (float)((e[0] * e[0] + e[1] * e[1] + e[2] * e[2] > tolerance2) & (iterations[i] < IKMaxIterations));
+			iterations[i] += (int)live[i];
+
+			// A = J J^T + lambda^2 I is symmetric 3x3; y = A^-1 e by cofactors
+			float a[3][3];
+			for (int r = 0; r < 3; r++)
+				for (int c = 0; c < 3; c++)
+					a[r][c] = jac[r][0] * jac[c][0] + jac[r][1] * jac[c][1] + jac[r][2] * jac[c][2] + jac[r][3] * jac[c][3]
+						+ jac[r][4] * jac[c][4] + (r == c ? damping2 : 0.0f);
+			float c00 = a[1][1] * a[2][2] - a[1][2] * a[1][2];
+			float c01 = a[0][2] * a[1][2] - a[0][1] * a[2][2];
+			float c02 = a[0][1] * a[1][2] - a[0][2] * a[1][1];
+			float c11 = a[0][0] * a[2][2] - a[0][2] * a[0][2];
+			float c12 = a[0][1] * a[0][2] - a[0][0] * a[1][2];
+			float c22 = a[0][0] * a[1][1] - a[0][1] * a[0][1];
+			float invDet = 1.0f / (a[0][0] * c00 + a[0][1] * c01 + a[0][2] * c02);
+			float y0 = (c00 * e[0] + c01 * e[1] + c02 * e[2]) * invDet;
+			float y1 = (c01 * e[0] + c11 * e[1] + c12 * e[2]) * invDet;
+			float y2 = (c02 * e[0] + c12 * e[1] + c22 * e[2]) * invDet;
+			// Selects rather than std::min/max, which the compiler would turn into branches here
+			float dq[5], largest = 0.0f;
+			for (int k = 0; k < 5; k++) {
+				dq[k] = jac[0][k] * y0 + jac[1][k] * y1 + jac[2][k] * y2;
+				largest = fabsf(dq[k]) > largest ? fabsf(dq[k]) : largest;
+			}
+			float limit = IKMaxStep / (largest + 1e-20f);
+			float scale = live[i] * (limit < 1.0f ? limit : 1.0f);
+			for (int k = 0; k < 5; k++)
+				dq[k] *= scale;
+			float arm1 = q[1][i] + dq[1];
+			arm1 = arm1 > Arm1Limit ? Arm1Limit : arm1;
+			arm1 = arm1 < -Arm1Limit ? -Arm1Limit : arm1;
+			dq[1] = arm1 - q[1][i];
+
+			// Turn each angle's sine and cosine by its change; arm2's pair belongs to arm1 + arm2
+			float turns[5] = { dq[0], dq[1], dq[1] + dq[2], dq[3], dq[4] };
+			for (int k = 0; k < 5; k++) {
+				float ds, dc;
+				ikStepSinCos(turns[k], ds, dc);
+				float sn = sines[k][i] * dc + cosines[k][i] * ds;
+				cosines[k][i] = cosines[k][i] * dc - sines[k][i] * ds;
+				sines[k][i] = sn;
+				q[k][i] += dq[k];
+			}
+		}
+	}
+}
+
+// Solves every target of batch for an arm standing at (baseX, baseZ), starting from the seed angles
+void solveIK(IKBatch &batch, float baseX, float baseZ) {
+	solveIKLanes(batch, baseX, baseZ, IKBlock);
+}
+
+// Reads waypoints, one "x y z" per line in world space (blank lines and # comments are skipped),
+// and solves them in order for the current base position. The first waypoint starts from the current
+// pose and every later one from the previous solution, so neighbours stay on the same branch (elbow,
+// pen flip) and playback does not jump between them. Playback starts with the first simulation tick.
+bool loadTrajectory(const char* path) {
+	FILE* in = fopen(path, "r");
+	if (in == NULL) {
+		fprintf(stderr, "Cannot open %s\n", path);
+		return false;
+	}
+	std::vector<glm::vec3> points;
+	char line[256];
+	for (int number = 1; fgets(line, sizeof(line), in) != NULL; number++) {
+		const char* p = line;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '#' || *p == '\n' || *p == '\r' || *p == 0)
+			continue;
+		glm::vec3 point;
+		if (sscanf(p, "%f %f %f", &point.x, &point.y, &point.z) != 3) {
+			fprintf(stderr, "%s:%d: expected x y z\n", path, number);
+			fclose(in);
+			return false;
+		}
+		points.push_back(point);
+	}
+	fclose(in);
+
+	resizeIKBatch(Trajectory, (int)points.size());
+	IKBatch waypoint;
+	resizeIKBatch(waypoint, 1);
+	waypoint.Top[0] = rot_top;
+	waypoint.Arm1[0] = rot_arm1;
+	waypoint.Arm2[0] = rot_arm2;
+	waypoint.PenLong[0] = rot_pen_long;
+	waypoint.PenLat[0] = rot_pen_lat;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < Trajectory.Count; i++) {
+		// The previous solution is still in the lane's seed
+		waypoint.TargetX[0] = Trajectory.TargetX[i] = points[i].x;
+		waypoint.TargetY[0] = Trajectory.TargetY[i] = points[i].y;
+		waypoint.TargetZ[0] = Trajectory.TargetZ[i] = points[i].z;
+		solveIKLanes(waypoint, trans_base_x, trans_base_z, 1);
+		Trajectory.Top[i] = waypoint.Top[0];
+		Trajectory.Arm1[i] = waypoint.Arm1[0];
+		Trajectory.Arm2[i] = waypoint.Arm2[0];
+		Trajectory.PenLong[i] = waypoint.PenLong[0];
+		Trajectory.PenLat[i] = waypoint.PenLat[0];
+		Trajectory.Error[i] = waypoint.Error[0];
+		Trajectory.Iterations[i] = waypoint.Iterations[0];
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	int missed = 0;
+	float worst = 0.0f;
+	for (int i = 0; i < Trajectory.Count; i++) {
+		missed += Trajectory.Error[i] > IKTolerance;
+		worst = std::max(worst, Trajectory.Error[i]);
+	}
+	printf("%s: %d waypoints solved in %.2f ms, %d out of reach (worst miss %.4f)\n", path, Trajectory.Count, ms, missed, worst);
+	TrajectoryStep = Trajectory.Count > 0 ? 0 : -1;
+	return true;
+}
+
+// Poses the arm at the next waypoint; called by the simulation thread with SimInputMutex held
+static void playTrajectoryStep(void) {
+	int i = TrajectoryStep;
+	JointState from = currentJoints();
+	JointState to = from;
+	to.rot_top = Trajectory.Top[i];
+	to.rot_arm1 = Trajectory.Arm1[i];
+	to.rot_arm2 = Trajectory.Arm2[i];
+	to.rot_pen_long = Trajectory.PenLong[i];
+	to.rot_pen_lat = Trajectory.PenLat[i];
+	clampMove(from, to);
+	setJoints(to);
+	TrajectoryStep = i + 1 < Trajectory.Count ? i + 1 : -1;
+}
+
+static inline float ikRandom(unsigned int &seed) {
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) * (1.0f / 16777216.0f);
+}
+
+// --bench-ik [targets]: checks ikChain against the transform hierarchy, then solves random
+// reachable targets from the rest pose, one lane at a time and in blocks
+int benchIK(int count) {
+	count = std::max(count, 1);
+	createHierarchy();
+	unsigned int seed = 12345u;
+	float worstChain = 0.0f;
+	for (int i = 0; i < 10000; i++) {
+		JointState joints = currentJoints();
+		joints.trans_base_x = 4.0f * ikRandom(seed) - 2.0f;
+		joints.trans_base_z = 4.0f * ikRandom(seed) - 2.0f;
+		joints.rot_top = 2.0f * PI * ikRandom(seed) - PI;
+		joints.rot_arm1 = 2.0f * Arm1Limit * ikRandom(seed) - Arm1Limit;
+		joints.rot_arm2 = 2.0f * PI * ikRandom(seed) - PI;
+		joints.rot_pen_long = 2.0f * PI * ikRandom(seed) - PI;
+		joints.rot_pen_lat = 2.0f * PI * ikRandom(seed) - PI;
+		joints.rot_pen_twist = 2.0f * PI * ikRandom(seed) - PI;
+		glm::vec3 expected = glm::vec3(nodeMatrixFromState(NODE_SOLID, joints) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		float tip[3], jac[3][5];
+		ikChain(joints.rot_top, joints.rot_arm1, joints.rot_arm2, joints.rot_pen_long, joints.rot_pen_lat,
+			joints.trans_base_x, joints.trans_base_z, tip, jac);
+		worstChain = std::max(worstChain, glm::length(expected - glm::vec3(tip[0], tip[1], tip[2])));
+	}
+	printf("ikChain vs hierarchy: worst tip difference %.2e over 10000 poses\n", worstChain);
+	if (worstChain > 1e-4f)
+		return 1;
+
+	IKBatch targets;
+	resizeIKBatch(targets, count);
+	for (int i = 0; i < count; i++) {
+		float tip[3], jac[3][5];
+		ikChain(2.0f * PI * ikRandom(seed) - PI, 2.0f * Arm1Limit * ikRandom(seed) - Arm1Limit, 2.0f * PI * ikRandom(seed) - PI,
+			2.0f * PI * ikRandom(seed) - PI, 2.0f * PI * ikRandom(seed) - PI, 0.0f, 0.0f, tip, jac);
+		targets.TargetX[i] = tip[0];
+		targets.TargetY[i] = tip[1];
+		targets.TargetZ[i] = tip[2];
+	}
+
+	int failed = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		int lanes = pass == 0 ? 1 : IKBlock;
+		IKBatch batch = targets;
+		for (int i = 0; i < count; i++)
+			batch.Top[i] = batch.Arm1[i] = batch.Arm2[i] = batch.PenLong[i] = batch.PenLat[i] = 0.0f;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		solveIKLanes(batch, 0.0f, 0.0f, lanes);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		int converged = 0, outside = 0;
+		long long totalIterations = 0;
+		float worst = 0.0f;
+		std::vector<int> iterations(batch.Iterations);
+		std::sort(iterations.begin(), iterations.end());
+		for (int i = 0; i < count; i++) {
+			converged += batch.Error[i] <= IKTolerance;
+			outside += batch.Arm1[i] < -Arm1Limit || batch.Arm1[i] > Arm1Limit;
+			totalIterations += batch.Iterations[i];
+			worst = std::max(worst, batch.Error[i]);
+		}
+		printf("%2d lane%s: %d targets in %.2f ms (%.2f M targets/s), %.2f%% converged, iterations mean %.1f p99 %d, worst miss %.4f\n",
+			lanes, lanes == 1 ? " " : "s", count, ms, count / ms / 1000.0, 100.0 * converged / count, (double)totalIterations / count,
+			iterations[(count - 1) * 99 / 100], worst);
+		if (outside > 0) {
+			printf("%d solutions violate the arm1 limits\n", outside);
+			failed++;
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
+
+//-- SELF COLLISION --//
+
+// World matrices of the arm's nodes, root to button, for the given joint values
+void poseArm(const JointState &joints, glm::mat4* world) {
+	world[NODE_ROOT] = NodeLocal[NODE_ROOT];
+	for (int node = NODE_BASE; node <= NODE_BUTTON; node++)
+		world[node] = world[NodeParent[node]] * jointLocalMatrix(node, joints);
+}
+
+// The parts are convex, so the hull's vertices are the mesh's distinct positions; vertices split
+// only by their normals collapse into one
+void buildHull(const std::vector<glm::vec3> &positions, std::vector<glm::vec3> &hull) {
+	hull = positions;
+	std::sort(hull.begin(), hull.end(), [](const glm::vec3 &a, const glm::vec3 &b) {
+		return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+	});
+	hull.erase(std::unique(hull.begin(), hull.end()), hull.end());
+}
+
+static inline glm::vec3 hullSupport(const std::vector<glm::vec3> &hull, const glm::vec3 &dir) {
+	size_t best = 0;
+	float bestDot = glm::dot(hull[0], dir);
+	for (size_t i = 1; i < hull.size(); i++) {
+		float d = glm::dot(hull[i], dir);
+		if (d > bestDot) {
+			bestDot = d;
+			best = i;
+		}
+	}
+	return hull[best];
+}
+
+// Support point of the Minkowski difference a - b in a's frame; b is placed in it by rot and offset
+static inline glm::vec3 minkowskiSupport(const std::vector<glm::vec3> &a, const std::vector<glm::vec3> &b,
+	const glm::mat3 &rot, const glm::vec3 &offset, const glm::vec3 &dir) {
+	return hullSupport(a, dir) - (rot * hullSupport(b, -dir * rot) + offset);
+}
+
+// Triangle simplex, newest point last: keeps the feature nearest the origin and points dir at it
+static bool gjkTriangle(glm::vec3* s, int &n, glm::vec3 &dir) {
+	glm::vec3 a = s[2], b = s[1], c = s[0], ao = -a;
+	glm::vec3 ab = b - a, ac = c - a, abc = glm::cross(ab, ac);
+	if (glm::dot(glm::cross(abc, ac), ao) > 0.0f && glm::dot(ac, ao) > 0.0f) {
+		s[0] = c;
+		s[1] = a;
+		n = 2;
+		dir = glm::cross(glm::cross(ac, ao), ac);
+	} else if (glm::dot(glm::cross(abc, ac), ao) > 0.0f || glm::dot(glm::cross(ab, abc), ao) > 0.0f) {
+		if (glm::dot(ab, ao) > 0.0f) {
+			s[0] = b;
+			s[1] = a;
+			n = 2;
+			dir = glm::cross(glm::cross(ab, ao), ab);
+		} else {
+			s[0] = a;
+			n = 1;
+			dir = ao;
+		}
+	} else {
+		dir = glm::dot(abc, ao) > 0.0f ? abc : -abc;
+	}
+	return false;
+}
+
+// Reduces the simplex (newest point last) and sets the next search direction; true once it
+// encloses the origin
+static bool gjkSimplex(glm::vec3* s, int &n, glm::vec3 &dir) {
+	glm::vec3 a = s[n - 1], ao = -a;
+	if (n == 2) {
+		glm::vec3 ab = s[0] - a;
+		if (glm::dot(ab, ao) > 0.0f) {
+			dir = glm::cross(glm::cross(ab, ao), ab);
+		} else {
+			s[0] = a;
+			n = 1;
+			dir = ao;
+		}
+		return false;
+	}
+	if (n == 3)
+		return gjkTriangle(s, n, dir);
+
+	// Tetrahedron: the origin is outside if it is beyond one of the faces through a, each
+	// oriented away from the opposite corner
+	glm::vec3 b = s[2], c = s[1], d = s[0];
+	glm::vec3 abc = glm::cross(b - a, c - a), acd = glm::cross(c - a, d - a), adb = glm::cross(d - a, b - a);
+	if (glm::dot(abc, d - a) > 0.0f)
+		abc = -abc;
+	if (glm::dot(acd, b - a) > 0.0f)
+		acd = -acd;
+	if (glm::dot(adb, c - a) > 0.0f)
+		adb = -adb;
+	glm::vec3 face[3];
+	if (glm::dot(abc, ao) > 0.0f) {
+		face[0] = c; face[1] = b;
+	} else if (glm::dot(acd, ao) > 0.0f) {
+		face[0] = d; face[1] = c;
+	} else if (glm::dot(adb, ao) > 0.0f) {
+		face[0] = b; face[1] = d;
+	} else {
+		return true;
+	}
+	s[0] = face[0];
+	s[1] = face[1];
+	s[2] = a;
+	n = 3;
+	return gjkTriangle(s, n, dir);
+}
+
+// Boolean GJK on two hulls, b placed in a's frame. dir seeds the search and receives the separating
+// direction when the hulls are apart, so a pair that stays apart is settled by one support point.
+// Touching counts as contact, and so does a run that has not settled after GJKMaxIterations.
+static bool gjkIntersect(const std::vector<glm::vec3> &a, const std::vector<glm::vec3> &b,
+	const glm::mat3 &rot, const glm::vec3 &offset, glm::vec3 &dir) {
+	if (glm::dot(dir, dir) < 1e-12f)
+		dir = glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 s[4];
+	s[0] = minkowskiSupport(a, b, rot, offset, dir);
+	if (glm::dot(s[0], dir) < 0.0f)
+		return false;
+	int n = 1;
+	glm::vec3 d = -s[0];
+	for (int i = 0; i < GJKMaxIterations; i++) {
+		if (glm::dot(d, d) < 1e-12f)
+			return true;	// the origin is on the simplex
+		glm::vec3 p = minkowskiSupport(a, b, rot, offset, d);
+		if (glm::dot(p, d) < 0.0f) {
+			dir = d;
+			return false;
+		}
+		s[n++] = p;
+		if (gjkSimplex(s, n, d))
+			return true;
+	}
+	return true;
+}
+
+// Places pair.NodeB in pair.NodeA's frame. The hierarchy has no scale, so inverting a world matrix
+// is a transpose.
+static void pairFrame(const CollisionPair &pair, const glm::mat4* world, glm::mat3 &rot, glm::vec3 &offset) {
+	glm::mat3 toA = glm::transpose(glm::mat3(world[pair.NodeA]));
+	rot = toA * glm::mat3(world[pair.NodeB]);
+	offset = toA * (glm::vec3(world[pair.NodeB][3]) - glm::vec3(world[pair.NodeA][3]));
+}
+
+static bool pairCollides(CollisionPair &pair, const glm::mat4* world) {
+	int objectA = NodeObject[pair.NodeA], objectB = NodeObject[pair.NodeB];
+	const glm::vec4 &sphereA = MeshSphere[objectA], &sphereB = MeshSphere[objectB];
+	glm::vec3 centerA = glm::vec3(world[pair.NodeA] * glm::vec4(glm::vec3(sphereA), 1.0f));
+	glm::vec3 centerB = glm::vec3(world[pair.NodeB] * glm::vec4(glm::vec3(sphereB), 1.0f));
+	float reach = sphereA.w + sphereB.w;
+	if (glm::dot(centerA - centerB, centerA - centerB) > reach * reach) {
+		SphereRejects++;
+		return false;
+	}
+	glm::mat3 rot;
+	glm::vec3 offset;
+	pairFrame(pair, world, rot, offset);
+	GJKRuns++;
+	return gjkIntersect(CollisionHulls[PickMeshSource[objectA]], CollisionHulls[PickMeshSource[objectB]], rot, offset, pair.Separation);
+}
+
+// Picks the pairs to check once every part's hull is in: all non-adjacent parts, except those
+// that already touch in the rest pose
+static void updateCollisionPairs(void) {
+	CollisionPairs.clear();
+	for (int node = NODE_BASE; node <= NODE_BUTTON; node++) {
+		if (CollisionHulls[PickMeshSource[NodeObject[node]]].empty())
+			return;
+	}
+	JointState rest;
+	memset(&rest, 0, sizeof(rest));
+	glm::mat4 world[NODE_BUTTON + 1];
+	poseArm(rest, world);
+	for (int a = NODE_BASE; a <= NODE_BUTTON; a++) {
+		for (int b = a + 1; b <= NODE_BUTTON; b++) {
+			if (NodeParent[a] == b || NodeParent[b] == a)
+				continue;
+			CollisionPair pair = { a, b, glm::vec3(0.0f) };
+			if (!pairCollides(pair, world))
+				CollisionPairs.push_back(pair);
+		}
+	}
+	CollisionPairsValid = true;
+	HaveLastCheck = false;
+}
+
+// True when any checked pair overlaps in this pose. Called with SimInputMutex held; the last
+// answer is kept, so asking again about an unchanged pose costs nothing.
+bool armCollides(const JointState &joints) {
+	if (!CollisionPairsValid) {
+		updateCollisionPairs();
+		if (!CollisionPairsValid)
+			return false;
+	}
+	if (HaveLastCheck && memcmp(&joints, &LastCheckedJoints, sizeof(JointState)) == 0)
+		return LastCheckedResult;
+	glm::mat4 world[NODE_BUTTON + 1];
+	poseArm(joints, world);
+	bool hit = false;
+	for (size_t i = 0; i < CollisionPairs.size() && !hit; i++)
+		hit = pairCollides(CollisionPairs[i], world);
+	LastCheckedJoints = joints;
+	LastCheckedResult = hit;
+	HaveLastCheck = true;
+	return hit;
+}
+
+static JointState lerpJoints(const JointState &from, const JointState &to, float t) {
+	JointState joints;
+	joints.trans_base_x = from.trans_base_x + (to.trans_base_x - from.trans_base_x) * t;
+	joints.trans_base_z = from.trans_base_z + (to.trans_base_z - from.trans_base_z) * t;
+	joints.rot_top = from.rot_top + (to.rot_top - from.rot_top) * t;
+	joints.rot_arm1 = from.rot_arm1 + (to.rot_arm1 - from.rot_arm1) * t;
+	joints.rot_arm2 = from.rot_arm2 + (to.rot_arm2 - from.rot_arm2) * t;
+	joints.rot_pen_long = from.rot_pen_long + (to.rot_pen_long - from.rot_pen_long) * t;
+	joints.rot_pen_lat = from.rot_pen_lat + (to.rot_pen_lat - from.rot_pen_lat) * t;
+	joints.rot_pen_twist = from.rot_pen_twist + (to.rot_pen_twist - from.rot_pen_twist) * t;
+	return joints;
+}
+
+// Cuts the move from one pose to another back to the furthest point along it without contact.
+// Returns true when the move stands as it is. An arm that is already in contact may move freely,
+// so it can always be backed out. Called with SimInputMutex held.
+bool clampMove(const JointState &from, JointState &to) {
+	if (!armCollides(to) || armCollides(from))
+		return true;
+	float lo = 0.0f, hi = 1.0f;
+	for (int i = 0; i < ClampSteps; i++) {
+		float mid = 0.5f * (lo + hi);
+		if (armCollides(lerpJoints(from, to, mid)))
+			hi = mid;
+		else
+			lo = mid;
+	}
+	to = lerpJoints(from, to, lo);
+	MovesClamped++;
+	return false;
+}
+
+// Separating axis test of two convex meshes over their face normals and the cross products of
+// their edges, the reference for benchCollision. Returns the largest gap along any axis, which is
+// negative (the least overlap) when the meshes intersect.
+static float satGap(const MeshBVH &a, const MeshBVH &b, const glm::mat3 &rot, const glm::vec3 &offset) {
+	std::vector<glm::vec3> pointsB(b.Positions.size());
+	for (size_t i = 0; i < pointsB.size(); i++)
+		pointsB[i] = rot * b.Positions[i] + offset;
+	std::vector<glm::vec3> normals, edgesA, edgesB;
+	for (int mesh = 0; mesh < 2; mesh++) {
+		const std::vector<GLushort> &idx = mesh == 0 ? a.Indices : b.Indices;
+		const std::vector<glm::vec3> &pos = mesh == 0 ? a.Positions : pointsB;
+		std::vector<glm::vec3> &edges = mesh == 0 ? edgesA : edgesB;
+		for (size_t t = 0; t + 2 < idx.size(); t += 3) {
+			glm::vec3 p0 = pos[idx[t]], p1 = pos[idx[t + 1]], p2 = pos[idx[t + 2]];
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			if (glm::length(n) > 1e-9f)
+				normals.push_back(glm::normalize(n));
+			glm::vec3 e[3] = { p1 - p0, p2 - p1, p0 - p2 };
+			for (int k = 0; k < 3; k++) {
+				if (glm::length(e[k]) > 1e-9f)
+					edges.push_back(glm::normalize(e[k]));
+			}
+		}
+	}
+	std::vector<glm::vec3> axes = normals;
+	for (size_t i = 0; i < edgesA.size(); i++) {
+		for (size_t j = 0; j < edgesB.size(); j++) {
+			glm::vec3 n = glm::cross(edgesA[i], edgesB[j]);
+			if (glm::length(n) > 1e-6f)
+				axes.push_back(glm::normalize(n));
+		}
+	}
+	float gap = -FLT_MAX;
+	for (size_t i = 0; i < axes.size(); i++) {
+		float minA = FLT_MAX, maxA = -FLT_MAX, minB = FLT_MAX, maxB = -FLT_MAX;
+		for (size_t k = 0; k < a.Positions.size(); k++) {
+			float d = glm::dot(a.Positions[k], axes[i]);
+			minA = std::min(minA, d);
+			maxA = std::max(maxA, d);
+		}
+		for (size_t k = 0; k < pointsB.size(); k++) {
+			float d = glm::dot(pointsB[k], axes[i]);
+			minB = std::min(minB, d);
+			maxB = std::max(maxB, d);
+		}
+		gap = std::max(gap, std::max(minB - maxA, minA - maxB));
+	}
+	return gap;
+}
+
+// --bench-collision [poses]: loads the part hulls without a window, checks GJK against the
+// separating axis test on random poses, then times whole-arm checks on random poses, on arrow
+// key sized steps and on IK solutions, and times clamping moves
+int benchCollision(int count) {
+	count = std::max(count, 1);
+	const char* files[] = { "Base.obj", "Top.obj", "Arm1.obj", "Joint.obj", "Arm2.obj", "Pen.obj", "Button.obj" };
+	for (int i = 0; i < 7; i++) {
+		int ObjectId = 2 + i;
+		ArenaScope scope(LoadArena);
+		StagingVector<PackedVertex> verts;
+		StagingVector<GLushort> idcs;
+		glm::vec3 boundsMin, boundsMax;
+		if (!parseObject(files[i], verts, idcs, boundsMin, boundsMax, ObjectLods[ObjectId]))
+			return 1;
+		setMeshBounds(ObjectId, boundsMin, boundsMax);
+		computeMeshBounds(ObjectId, verts.data(), verts.size());
+		buildMeshBVH(PickMeshes[ObjectId], verts.data(), verts.size(), idcs.data(), ObjectLods[ObjectId].Indices[0], PositionScale[ObjectId], PositionBias[ObjectId]);
+		buildHull(PickMeshes[ObjectId].Positions, CollisionHulls[ObjectId]);
+		ObjectName[ObjectId] = files[i];
+		PickMeshSource[ObjectId] = ObjectId;
+		printf("%-11s %3d hull points\n", files[i], (int)CollisionHulls[ObjectId].size());
+	}
+	createHierarchy();
+
+	std::vector<JointState> poses(count);
+	unsigned int seed = 12345u;
+	for (int i = 0; i < count; i++) {
+		memset(&poses[i], 0, sizeof(JointState));
+		poses[i].rot_top = 2.0f * PI * ikRandom(seed) - PI;
+		poses[i].rot_arm1 = 2.0f * Arm1Limit * ikRandom(seed) - Arm1Limit;
+		poses[i].rot_arm2 = 2.0f * PI * ikRandom(seed) - PI;
+		poses[i].rot_pen_long = 2.0f * PI * ikRandom(seed) - PI;
+		poses[i].rot_pen_lat = 2.0f * PI * ikRandom(seed) - PI;
+		poses[i].rot_pen_twist = 2.0f * PI * ikRandom(seed) - PI;
+	}
+	armCollides(poses[0]);
+
+	// GJK against the separating axis test, pair by pair; gaps within 1e-4 count as touching either way
+	int compared = 0, mismatches = 0;
+	for (int i = 0; i < std::min(count, 2000); i++) {
+		glm::mat4 world[NODE_BUTTON + 1];
+		poseArm(poses[i], world);
+		for (size_t p = 0; p < CollisionPairs.size(); p++) {
+			CollisionPair pair = CollisionPairs[p];
+			pair.Separation = glm::vec3(0.0f);
+			glm::mat3 rot;
+			glm::vec3 offset;
+			pairFrame(pair, world, rot, offset);
+			bool gjk = gjkIntersect(CollisionHulls[NodeObject[pair.NodeA]], CollisionHulls[NodeObject[pair.NodeB]], rot, offset, pair.Separation);
+			float gap = satGap(PickMeshes[NodeObject[pair.NodeA]], PickMeshes[NodeObject[pair.NodeB]], rot, offset);
+			compared++;
+			if (fabsf(gap) > 1e-4f && gjk != (gap < 0.0f))
+				mismatches++;
+		}
+	}
+	printf("%d pair tests against the separating axis test, %d mismatches\n", compared, mismatches);
+
+	const char* names[] = { "random poses", "arrow key steps", "IK solutions" };
+	for (int set = 0; set < 3; set++) {
+		std::vector<JointState> checks = poses;
+		if (set == 1) {
+			// A walk through pose space, one PI / 10 step of one joint at a time
+			for (int i = 1; i < count; i++) {
+				checks[i] = checks[i - 1];
+				float step = ikRandom(seed) < 0.5f ? PI / 10 : -PI / 10;
+				float* joint[] = { &checks[i].rot_top, &checks[i].rot_arm1, &checks[i].rot_arm2, &checks[i].rot_pen_long, &checks[i].rot_pen_lat };
+				*joint[(int)(5 * ikRandom(seed)) % 5] += step;
+			}
+		} else if (set == 2) {
+			IKBatch batch;
+			resizeIKBatch(batch, count);
+			for (int i = 0; i < count; i++) {
+				float r = 1.0f + 3.0f * ikRandom(seed), angle = 2.0f * PI * ikRandom(seed);
+				batch.TargetX[i] = r * cosf(angle);
+				batch.TargetY[i] = 4.0f * ikRandom(seed);
+				batch.TargetZ[i] = r * sinf(angle);
+				batch.Top[i] = batch.Arm1[i] = batch.Arm2[i] = batch.PenLong[i] = batch.PenLat[i] = 0.0f;
+			}
+			solveIK(batch, 0.0f, 0.0f);
+			for (int i = 0; i < count; i++) {
+				checks[i].rot_top = batch.Top[i];
+				checks[i].rot_arm1 = batch.Arm1[i];
+				checks[i].rot_arm2 = batch.Arm2[i];
+				checks[i].rot_pen_long = batch.PenLong[i];
+				checks[i].rot_pen_lat = batch.PenLat[i];
+				checks[i].rot_pen_twist = 0.0f;
+			}
+		}
+		SphereRejects = 0;
+		GJKRuns = 0;
+		int hits = 0;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < count; i++)
+			hits += armCollides(checks[i]);
+		double us = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+		printf("%-16s %.3f us per check, %.1f%% in contact, %.2f sphere rejects and %.2f GJK runs per check\n",
+			names[set], us / count, 100.0 * hits / count, (double)SphereRejects / count, (double)GJKRuns / count);
+	}
+
+	// Clamping random PI / 10 steps out of poses without contact
+	int moves = 0;
+	MovesClamped = 0;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < count; i++) {
+		if (armCollides(poses[i]))
+			continue;
+		JointState to = poses[i];
+		to.rot_arm2 += ikRandom(seed) < 0.5f ? PI / 10 : -PI / 10;
+		to.rot_pen_long += ikRandom(seed) < 0.5f ? PI / 10 : -PI / 10;
+		clampMove(poses[i], to);
+		moves++;
+	}
+	double us = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("%d moves, %d clamped, %.3f us per move\n", moves, MovesClamped, us / std::max(moves, 1));
+	arenaRelease(LoadArena);
+	stopWorkers();
+	return mismatches == 0 ? 0 : 1;
+}
+
+//-- ARM FLEET --//
+
+// Lays count arms out on a square grid centered on the main arm, which stays clear between cells
+void createFleet(int count) {
+	Fleet.Count = count;
+	Fleet.BaseX.resize(count);
+	Fleet.BaseZ.resize(count);
+	Fleet.Top.resize(count);
+	Fleet.Arm1.resize(count);
+	Fleet.Arm2.resize(count);
+	Fleet.PenLong.resize(count);
+	Fleet.PenLat.resize(count);
+	Fleet.PenTwist.resize(count);
+	Fleet.Phase.resize(count);
+	Fleet.Speed.resize(count);
+	int side = (int)ceil(sqrt((double)count));
+	unsigned int seed = 12345u;
+	for (int i = 0; i < count; i++) {
+		Fleet.BaseX[i] = (i % side - side / 2 + 0.5f) * FleetSpacing;
+		Fleet.BaseZ[i] = (i / side - side / 2 + 0.5f) * FleetSpacing;
+		Fleet.Phase[i] = 2.0f * PI * ikRandom(seed);
+		Fleet.Speed[i] = 0.5f + ikRandom(seed);
+	}
+}
+
+void createFleetVAO(void) {
+	glGenVertexArrays(1, &FleetVAO);
+	attachMeshArena(FleetVAO);
+	glBindVertexArray(FleetVAO);
+	glGenBuffers(1, &FleetMatrixBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, FleetMatrixBuffer);
+	// The mat4 takes attributes 7 to 10; submitRenderList() points them at each part's run of matrices
+	for (int k = 0; k < 4; k++) {
+		glVertexAttribDivisor(7 + k, 1);
+		glEnableVertexAttribArray(7 + k);
+	}
+	glBindVertexArray(0);
+}
+
+// Bounding sphere radius of a whole arm around its base, in any pose
+static float fleetArmRadius(void) {
+	float parts = 0.0f;
+	for (int node = NODE_BASE; node <= NODE_BUTTON; node++) {
+		const glm::vec4 &sphere = MeshSphere[NodeObject[node]];
+		parts = std::max(parts, glm::length(glm::vec3(sphere)) + sphere.w);
+	}
+	return IKTopHeight + IKArm1Length + IKArm2Length + parts;
+}
+
+// Poses one chunk of the visible arms and walks each one's chain, root to button, with the same
+// local matrices as the main arm
+static void poseFleetChunk(void* context, int chunk) {
+	int visible = (int)FleetVisible.size();
+	int end = std::min(visible, (chunk + 1) * FleetChunk);
+	float t = (float)FleetTime;
+	for (int k = chunk * FleetChunk; k < end; k++) {
+		int arm = FleetVisible[k];
+		float phase = Fleet.Phase[arm];
+		float w = Fleet.Speed[arm] * t;
+		Fleet.Top[arm] = phase + 0.4f * w;
+		Fleet.Arm1[arm] = 0.6f * sinf(1.3f * w + phase);
+		Fleet.Arm2[arm] = 0.8f * sinf(0.9f * w + 2.0f * phase);
+		Fleet.PenLong[arm] = 0.5f * sinf(2.0f * w + phase);
+		Fleet.PenLat[arm] = 0.4f * cosf(1.7f * w + phase);
+		Fleet.PenTwist[arm] = w;
+
+		JointState joints;
+		joints.trans_base_x = Fleet.BaseX[arm];
+		joints.trans_base_z = Fleet.BaseZ[arm];
+		joints.rot_top = Fleet.Top[arm];
+		joints.rot_arm1 = Fleet.Arm1[arm];
+		joints.rot_arm2 = Fleet.Arm2[arm];
+		joints.rot_pen_long = Fleet.PenLong[arm];
+		joints.rot_pen_lat = Fleet.PenLat[arm];
+		joints.rot_pen_twist = Fleet.PenTwist[arm];
+		glm::mat4 world[NODE_BUTTON + 1];
+		poseArm(joints, world);
+		for (int node = NODE_BASE; node <= NODE_BUTTON; node++)
+			FleetMatrices[(size_t)(node - NODE_BASE) * visible + k] = world[node];
+	}
+}
+
+// Culls whole arms against the frustum planes of this frame, then poses the visible ones in parallel
+void updateFleet(double time) {
+	FleetVisible.clear();
+	float radius = fleetArmRadius();
+	for (int arm = 0; arm < Fleet.Count; arm++) {
+		glm::vec3 center(Fleet.BaseX[arm], 0.0f, Fleet.BaseZ[arm]);
+		bool inside = true;
+		for (int i = 0; i < 6 && inside; i++)
+			inside = glm::dot(glm::vec3(FrustumPlanes[i]), center) + FrustumPlanes[i].w >= -radius;
+		if (inside)
+			FleetVisible.push_back(arm);
+	}
+	FleetArmsDrawn = (int)FleetVisible.size();
+	if (FleetArmsDrawn == 0)
+		return;
+	FleetMatrices.resize((size_t)FleetParts * FleetArmsDrawn);
+	FleetTime = time;
+	runParallel(FramePool, (FleetArmsDrawn + FleetChunk - 1) / FleetChunk, poseFleetChunk, NULL, 0);
+}
+
+//-- PICKING --//
+
+// Splits node's triangle range at the centroid median of its longest axis until leaves are small
+static void buildBVHNode(MeshBVH &bvh, int node, int first, int count, StagingVector<int> &order, const StagingVector<glm::vec3> &centroids) {
+	glm::vec3 lo(FLT_MAX, FLT_MAX, FLT_MAX), hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	glm::vec3 clo = lo, chi = hi;
+	for (int i = first; i < first + count; i++) {
+		int tri = order[i];
+		for (int k = 0; k < 3; k++) {
+			const glm::vec3 &p = bvh.Positions[bvh.Indices[3 * tri + k]];
+			lo = glm::vec3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+			hi = glm::vec3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+		}
+		const glm::vec3 &c = centroids[tri];
+		clo = glm::vec3(std::min(clo.x, c.x), std::min(clo.y, c.y), std::min(clo.z, c.z));
+		chi = glm::vec3(std::max(chi.x, c.x), std::max(chi.y, c.y), std::max(chi.z, c.z));
+	}
+	bvh.Nodes[node].Min = lo;
+	bvh.Nodes[node].Max = hi;
+	if (count <= BVHLeafSize) {
+		bvh.Nodes[node].First = first;
+		bvh.Nodes[node].Count = count;
+		return;
+	}
+
+	glm::vec3 extent = chi - clo;
+	int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+	int mid = first + count / 2;
+	std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + first + count,
+		[&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+	int left = (int)bvh.Nodes.size();
+	bvh.Nodes.resize(left + 2);
+	bvh.Nodes[node].First = left;
+	bvh.Nodes[node].Count = 0;
+	buildBVHNode(bvh, left, first, mid - first, order, centroids);
+	buildBVHNode(bvh, left + 1, mid, first + count - mid, order, centroids);
+}
+
+// Copies a mesh's dequantized positions and triangles and builds its BVH
+void buildMeshBVH(MeshBVH &bvh, const PackedVertex* verts, size_t vertCount, const GLushort* idx, size_t idxCount, const glm::vec4 &scale, const glm::vec4 &bias) {
+	bvh.Positions.resize(vertCount);
+	for (size_t i = 0; i < vertCount; i++)
+		bvh.Positions[i] = unpackPosition(verts[i], scale, bias);
+	bvh.Indices.assign(idx, idx + idxCount);
+	bvh.Nodes.clear();
+
+	int triCount = (int)(idxCount / 3);
+	if (triCount == 0)
+		return;
+	StagingVector<int> order(triCount);
+	StagingVector<glm::vec3> centroids(triCount);
+	for (int t = 0; t < triCount; t++) {
+		order[t] = t;
+		centroids[t] = (bvh.Positions[idx[3 * t]] + bvh.Positions[idx[3 * t + 1]] + bvh.Positions[idx[3 * t + 2]]) / 3.0f;
+	}
+	bvh.Nodes.resize(1);
+	buildBVHNode(bvh, 0, 0, triCount, order, centroids);
+
+	// Store triangles in leaf order
+	for (int t = 0; t < triCount; t++)
+		for (int k = 0; k < 3; k++)
+			bvh.Indices[3 * t + k] = idx[3 * order[t] + k];
+}
+
+// Moller-Trumbore, two-sided
+static bool intersectTriangle(const glm::vec3 &orig, const glm::vec3 &dir, const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2, float &t) {
+	glm::vec3 e1 = v1 - v0;
+	glm::vec3 e2 = v2 - v0;
+	glm::vec3 p = glm::cross(dir, e2);
+	float det = glm::dot(e1, p);
+	if (fabsf(det) < 1e-12f)
+		return false;
+	float invDet = 1.0f / det;
+	glm::vec3 s = orig - v0;
+	float u = glm::dot(s, p) * invDet;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+	glm::vec3 q = glm::cross(s, e1);
+	float v = glm::dot(dir, q) * invDet;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+	t = glm::dot(e2, q) * invDet;
+	return t > 0.0f;
+}
+
+// Slab test; returns the entry distance, or FLT_MAX when the box is missed or beyond limit
+static float intersectBox(const glm::vec3 &orig, const glm::vec3 &invDir, const BVHNode &node, float limit) {
+	float t0 = 0.0f, t1 = limit;
+	for (int a = 0; a < 3; a++) {
+		float tNear = (node.Min[a] - orig[a]) * invDir[a];
+		float tFar = (node.Max[a] - orig[a]) * invDir[a];
+		if (tNear > tFar)
+			std::swap(tNear, tFar);
+		t0 = std::max(t0, tNear);
+		t1 = std::min(t1, tFar);
+		if (t0 > t1)
+			return FLT_MAX;
+	}
+	return t0;
+}
+
+// Nearest hit of a ray in mesh space, t in units of dir. Closer children are visited first
+// and subtrees farther than the best hit so far are skipped.
+bool intersectMeshBVH(const MeshBVH &bvh, const glm::vec3 &orig, const glm::vec3 &dir, float &t) {
+	if (bvh.Nodes.empty())
+		return false;
+	glm::vec3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+	float best = FLT_MAX;
+	int stack[64];
+	int top = 0;
+	if (intersectBox(orig, invDir, bvh.Nodes[0], best) != FLT_MAX)
+		stack[top++] = 0;
+	while (top > 0) {
+		const BVHNode &node = bvh.Nodes[stack[--top]];
+		if (node.Count > 0) {
+			for (int i = node.First; i < node.First + node.Count; i++) {
+				float hit;
+				if (intersectTriangle(orig, dir, bvh.Positions[bvh.Indices[3 * i]], bvh.Positions[bvh.Indices[3 * i + 1]],
+					bvh.Positions[bvh.Indices[3 * i + 2]], hit) && hit < best)
+					best = hit;
+			}
+			continue;
+		}
+		int left = node.First, right = node.First + 1;
+		float tl = intersectBox(orig, invDir, bvh.Nodes[left], best);
+		float tr = intersectBox(orig, invDir, bvh.Nodes[right], best);
+		if (tl > tr) {
+			std::swap(tl, tr);
+			std::swap(left, right);
+		}
+		if (tr != FLT_MAX)
+			stack[top++] = right;
+		if (tl != FLT_MAX)
+			stack[top++] = left;
+	}
+	if (best == FLT_MAX)
+		return false;
+	t = best;
+	return true;
+}
+
+// World-space ray through a window position (origin at the top left, as GLFW reports the cursor)
+void cursorRay(double xpos, double ypos, glm::vec3 &origin, glm::vec3 &dir) {
+	float x = (float)(2.0 * xpos / window_width - 1.0);
+	float y = (float)(1.0 - 2.0 * ypos / window_height);
+	glm::mat4 inv = glm::inverse(gProjectionMatrix * gViewMatrix);
+	glm::vec4 nearPoint = inv * glm::vec4(x, y, -1.0f, 1.0f);
+	glm::vec4 farPoint = inv * glm::vec4(x, y, 1.0f, 1.0f);
+	origin = glm::vec3(nearPoint) / nearPoint.w;
+	dir = glm::vec3(farPoint) / farPoint.w - origin;
+}
+
+// Tests the ray against every drawn node using the cached world matrices. The ray is moved into
+// each mesh's space instead of transforming vertices; t stays comparable since the map is affine.
+bool pickRay(const glm::vec3 &origin, const glm::vec3 &dir, PickHit &hit) {
+	hit.Node = -1;
+	hit.ObjectId = -1;
+	hit.T = FLT_MAX;
+	for (size_t node = 0; node < NodeObject.size(); node++) {
+		int ObjectId = NodeObject[node];
+		if (ObjectId < 0 || !MeshResident[ObjectId])
+			continue;
+		glm::mat4 inv = glm::inverse(NodeWorld[node]);
+		glm::vec3 localOrigin = glm::vec3(inv * glm::vec4(origin, 1.0f));
+		glm::vec3 localDir = glm::vec3(inv * glm::vec4(dir, 0.0f));
+		float t;
+		if (intersectMeshBVH(PickMeshes[PickMeshSource[ObjectId]], localOrigin, localDir, t) && t < hit.T) {
+			hit.Node = (int)node;
+			hit.ObjectId = ObjectId;
+			hit.T = t;
+		}
+	}
+	if (hit.Node < 0)
+		return false;
+	hit.Point = origin + dir * hit.T;
+	return true;
+}
+
+// Reports the part under the cursor, ray cast against the pose drawn in the last frame
+void pickObject(void) {
+	double xpos, ypos;
+	glfwGetCursorPos(window, &xpos, &ypos);
+
+	glm::vec3 origin, dir;
+	cursorRay(xpos, ypos, origin, dir);
+	PickHit hit;
+	bool found = pickRay(origin, dir, hit);
+
+	if (!found) {
+		gPickedIndex = -1;
+		gMessage = "background";
+	}
+	else {
+		gPickedIndex = hit.ObjectId;
+		std::ostringstream oss;
+		oss.precision(3);
+		oss << ObjectName[hit.ObjectId] << " at (" << hit.Point.x << ", " << hit.Point.y << ", " << hit.Point.z << ")";
+		gMessage = oss.str();
+	}
+}
+
+// Brute-force ray test over every triangle, the reference for benchPick
+static bool intersectMeshBrute(const MeshBVH &bvh, const glm::vec3 &orig, const glm::vec3 &dir, float &t) {
+	float best = FLT_MAX;
+	for (size_t i = 0; i + 2 < bvh.Indices.size(); i += 3) {
+		float hit;
+		if (intersectTriangle(orig, dir, bvh.Positions[bvh.Indices[i]], bvh.Positions[bvh.Indices[i + 1]],
+			bvh.Positions[bvh.Indices[i + 2]], hit) && hit < best)
+			best = hit;
+	}
+	t = best;
+	return best != FLT_MAX;
+}
+
+// Builds the part BVHs without a GL context, then casts a grid of rays from the default camera and
+// checks every hit against brute force
+int benchPick(void) {
+	const char* files[] = { "Base.obj", "Top.obj", "Arm1.obj", "Joint.obj", "Arm2.obj", "Pen.obj", "Button.obj" };
+	for (int i = 0; i < 7; i++) {
+		int ObjectId = 2 + i;
+		ArenaScope scope(LoadArena);
+		StagingVector<PackedVertex> verts;
+		StagingVector<GLushort> idcs;
+		glm::vec3 boundsMin, boundsMax;
+		if (!parseObject(files[i], verts, idcs, boundsMin, boundsMax, ObjectLods[ObjectId]))
+			return 1;
+		setMeshBounds(ObjectId, boundsMin, boundsMax);
+		size_t idxCount = ObjectLods[ObjectId].Indices[0];
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		buildMeshBVH(PickMeshes[ObjectId], verts.data(), verts.size(), idcs.data(), idxCount, PositionScale[ObjectId], PositionBias[ObjectId]);
+		double us = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+		printf("%-11s %5d triangles %4d BVH nodes, built in %.1f us\n", files[i], (int)(idxCount / 3), (int)PickMeshes[ObjectId].Nodes.size(), us);
+		ObjectName[ObjectId] = files[i];
+		PickMeshSource[ObjectId] = ObjectId;
+	}
+	createHierarchy();
+	syncJointTransforms(currentJoints());
+	updateWorldTransforms();
+	gProjectionMatrix = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+	gViewMatrix = glm::lookAt(glm::vec3(10.0, 10.0, 10.0f), glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
+
+	int rays = 0, hits = 0, mismatches = 0;
+	double bvhUs = 0.0, bruteUs = 0.0;
+	for (int y = 0; y < window_height; y += 4) {
+		for (int x = 0; x < window_width; x += 4) {
+			glm::vec3 origin, dir;
+			cursorRay(x, y, origin, dir);
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			PickHit hit;
+			bool found = pickRay(origin, dir, hit);
+			std::chrono::high_resolution_clock::time_point mid = std::chrono::high_resolution_clock::now();
+
+			int bruteObject = -1;
+			float bruteT = FLT_MAX;
+			for (size_t node = 0; node < NodeObject.size(); node++) {
+				int ObjectId = NodeObject[node];
+				if (ObjectId < 0)
+					continue;
+				glm::mat4 inv = glm::inverse(NodeWorld[node]);
+				float t;
+				if (intersectMeshBrute(PickMeshes[PickMeshSource[ObjectId]], glm::vec3(inv * glm::vec4(origin, 1.0f)),
+					glm::vec3(inv * glm::vec4(dir, 0.0f)), t) && t < bruteT) {
+					bruteT = t;
+					bruteObject = ObjectId;
+				}
+			}
+			std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+			bvhUs += std::chrono::duration<double, std::micro>(mid - start).count();
+			bruteUs += std::chrono::duration<double, std::micro>(end - mid).count();
+
+			rays++;
+			if (found)
+				hits++;
+			if ((found ? hit.ObjectId : -1) != bruteObject || (found && fabsf(hit.T - bruteT) > 1e-6f * bruteT))
+				mismatches++;
+		}
+	}
+	printf("%d rays, %d hits: BVH %.2f us/ray, brute force %.2f us/ray, %d mismatches\n",
+		rays, hits, bvhUs / rays, bruteUs / rays, mismatches);
+	return mismatches == 0 ? 0 : 1;
+}
+
+//-- RENDER LIST --//
+
+// Pass in the top byte, then program and vertex array so packets sharing state end up adjacent; the
+// emission order in the low bits keeps draws with the same state in the order they were emitted
+static unsigned long long renderSortKey(int pass, GLuint program, GLuint vertexArray, size_t order) {
+	return ((unsigned long long)pass << 56) | ((unsigned long long)(program & 0xFFFF) << 40) |
+		((unsigned long long)(vertexArray & 0xFFFF) << 24) | (order & 0xFFFFFF);
+}
+
+static RenderPacket &addPacket(RenderList &list, int kind, GLuint vertexArray, int slot) {
+	RenderPacket packet = {};
+	packet.Key = renderSortKey(kind == PACKET_LINES ? PASS_LINES : PASS_OPAQUE, programID, vertexArray, list.Packets.size());
+	packet.Kind = kind;
+	packet.Program = programID;
+	packet.VertexArray = vertexArray;
+	packet.Instances = 1;
+	packet.Slot = slot;
+	list.Packets.push_back(packet);
+	return list.Packets.back();
+}
+
+// Walks the scene as it is at time: poses the arm, culls parts and fleet arms against the view, picks
+// levels of detail and emits one packet per draw. Issues no GL calls, so it can run on the scene thread.
+void prepareRenderList(RenderList &list, double time) {
+	/* Camera rotations
+	x = r * cos(latitudeAngle) * sin(longitudeAngle)
+	y = r * cos(longitudeAngle
+	z = r * sin(latitudeAngle) * sin(longitudeAngle)
+	*/
+	float x_cam, y_cam, z_cam, radius;
+	radius = sqrt(300);
+	x_cam = radius * cos(rot_camera_side) * sin(rot_camera_up);
+	y_cam = radius * cos(rot_camera_up);
+	z_cam = radius * sin(rot_camera_side) * sin(rot_camera_up);
+	CameraPosition = glm::vec3(x_cam, y_cam, z_cam);
+	gViewMatrix = glm::lookAt(glm::vec3(x_cam, y_cam, z_cam),	// eye
+		glm::vec3(0.0, 0.0, 0.0),	// center
+		glm::vec3(0.0, 1.0, 0.0));	// up
+
+	glm::vec3 lightPos = glm::vec3(4, 4, 4);
+	list.Frame.View = gViewMatrix;
+	list.Frame.Projection = gProjectionMatrix;
+	list.Frame.LightPosition = glm::vec4(lightPos, 1.0f);
+
+	// Pose and projectiles between the last two simulation ticks; only joints that moved
+	// since the last frame are recomputed
+	interpolateSnapshots(time);
+	syncJointTransforms(RenderJoints);
+	updateWorldTransforms();
+
+	// Axes and grid keep their vertex colors, then base, top, arm1, joint, arm2, pen, button and
+	// the solid. Parts outside the view get no slot.
+	extractFrustumPlanes(gProjectionMatrix * gViewMatrix);
+	list.Packets.clear();
+	list.NumSlots = 0;
+	list.PartsDrawn = 0;
+	list.PartsCulled = 0;
+	list.TrianglesDrawn = 0;
+	int lineSlot = addDrawSlot(list, glm::mat4(1.0), glm::vec4(1.0, 1.0, 1.0, 1.0), 0);
+	for (int ObjectId = 0; ObjectId < 2; ObjectId++) {
+		RenderPacket &packet = addPacket(list, PACKET_LINES, VertexArrayId[ObjectId], lineSlot);
+		packet.Count = (GLuint)NumVerts[ObjectId];
+	}
+	for (size_t i = 0; i < NodeParent.size(); i++) {
+		int ObjectId = NodeObject[i];
+		if (ObjectId < 0 || !MeshResident[ObjectId])
+			continue;
+		if (!partVisible(ObjectId, NodeWorld[i])) {
+			list.PartsCulled++;
+			continue;
+		}
+		int slot = addDrawSlot(list, NodeWorld[i], objectColor(ObjectId), ObjectId);
+		int level = selectLod((int)i, ObjectId, NodeWorld[i]);
+		const MeshLods &lods = ObjectLods[ObjectId];
+		// Every part comes from the arena, so they all share its vertex array
+		RenderPacket &packet = addPacket(list, PACKET_MESH, MeshArenaVAO, slot);
+		packet.Count = lods.Indices[level];
+		packet.First = MeshFirstIndex[ObjectId] + lods.First[level];
+		packet.BaseVertex = MeshBaseVertex[ObjectId];
+		list.TrianglesDrawn += lods.Indices[level] / 3;
+		list.PartsDrawn++;
+	}
+
+	// Solids: one instanced draw for every live projectile, each instance carries its own position
+	int solidSlot = addDrawSlot(list, glm::mat4(1.0), objectColor(9), 9);
+	list.Projectiles = NumRenderProjectiles;
+	if (NumRenderProjectiles > 0 && MeshResident[9]) {
+		RenderPacket &packet = addPacket(list, PACKET_PROJECTILES, ProjectileVAO, solidSlot);
+		packet.Count = (GLuint)NumIdcs[9];
+		packet.First = MeshFirstIndex[9];
+		packet.BaseVertex = MeshBaseVertex[9];
+		packet.Instances = NumRenderProjectiles;
+	}
+
+	// Fleet: one instanced draw per part; arms carry their own matrices and are never highlighted
+	if (Fleet.Count > 0)
+		updateFleet(time);
+	for (int p = 0; p < FleetParts && FleetArmsDrawn > 0; p++) {
+		int ObjectId = NodeObject[NODE_BASE + p];
+		int slot = addDrawSlot(list, glm::mat4(1.0), ObjectColor[ObjectId], ObjectId);
+		if (!MeshResident[ObjectId])
+			continue;
+		const MeshLods &lods = ObjectLods[ObjectId];
+		RenderPacket &packet = addPacket(list, PACKET_FLEET, FleetVAO, slot);
+		packet.Count = lods.Indices[0];
+		packet.First = MeshFirstIndex[ObjectId] + lods.First[0];
+		packet.BaseVertex = MeshBaseVertex[ObjectId];
+		packet.Instances = FleetArmsDrawn;
+		packet.InstanceOffset = sizeof(glm::mat4) * FleetArmsDrawn * p;
+		list.TrianglesDrawn += FleetArmsDrawn * (lods.Indices[0] / 3);
+	}
+	list.Ready = true;
+}
+
+// Sorts the packets by state and issues them. Runs of arena parts go out as one indirect multi-draw
+// when it is available; each command's base instance selects the part's ObjectBlock entry.
+void submitRenderList(RenderList &list) {
+	std::sort(list.Packets.begin(), list.Packets.end(), [](const RenderPacket &a, const RenderPacket &b) { return a.Key < b.Key; });
+
+	// Dark blue background
+	GL_COUNTED(glClearColor(0.0f, 0.0f, 0.2f, 0.0f));
+	// Re-clear the screen for real rendering
+	GL_COUNTED(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+
+	FrameData = list.Frame;
+	memcpy(DrawSlots, list.Slots, sizeof(ObjectUniforms) * list.NumSlots);
+	NumDrawSlots = list.NumSlots;
+	uploadFrameUniforms();
+	PartsDrawn = list.PartsDrawn;
+	PartsCulled = list.PartsCulled;
+	TrianglesDrawn = list.TrianglesDrawn;
+	ProjectilesDrawn = list.Projectiles;
+
+	// Meshes have no color attribute; vertex color is white and the draw color comes from ObjectBlock
+	GL_COUNTED(glVertexAttrib4f(1, 1.0f, 1.0f, 1.0f, 1.0f));
+
+	GLuint program = 0, vertexArray = 0;
+	bool fleetUploaded = false;
+	size_t count = list.Packets.size();
+	for (size_t i = 0; i < count; i++) {
+		const RenderPacket &packet = list.Packets[i];
+		if (packet.Program != program) {
+			GL_COUNTED(glUseProgram(packet.Program));
+			program = packet.Program;
+			CurrentObjectIndex = -1;	// uniform values are per program, start fresh
+		}
+		if (packet.VertexArray != vertexArray) {
+			GL_COUNTED(glBindVertexArray(packet.VertexArray));
+			vertexArray = packet.VertexArray;
+		}
+		switch (packet.Kind)
+		{
+		case PACKET_LINES:
+			setObjectIndex(packet.Slot);
+			GL_COUNTED(glDrawArrays(GL_LINES, packet.First, packet.Count));
+			break;
+		case PACKET_MESH: {
+			if (!UseMultiDrawIndirect) {
+				setObjectIndex(packet.Slot);
+				GL_COUNTED(glDrawElementsBaseVertex(GL_TRIANGLES, packet.Count, GL_UNSIGNED_SHORT,
+					(void*)(sizeof(GLushort) * packet.First), packet.BaseVertex));
+				break;
+			}
+			DrawElementsIndirectCommand commands[MaxDrawSlots];
+			int numCommands = 0;
+			for (; i < count && list.Packets[i].Kind == PACKET_MESH && (list.Packets[i].Key >> 24) == (packet.Key >> 24); i++) {
+				const RenderPacket &part = list.Packets[i];
+				DrawElementsIndirectCommand command = { part.Count, 1, part.First, part.BaseVertex, (GLuint)part.Slot };
+				commands[numCommands++] = command;
+			}
+			i--;
+			setObjectIndex(0);
+			GL_COUNTED(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, DrawIndirectBuffer));
+			GL_COUNTED(glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * MaxDrawSlots, NULL, GL_STREAM_DRAW));
+			GL_COUNTED(glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * numCommands, commands));
+			GL_COUNTED(glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)0, numCommands, 0));
+			break;
+		}
+		case PACKET_FLEET:
+			// Every visible arm's matrices in one upload, before the first part
+			if (!fleetUploaded) {
+				size_t bytes = sizeof(glm::mat4) * FleetMatrices.size();
+				GL_COUNTED(glBindBuffer(GL_ARRAY_BUFFER, FleetMatrixBuffer));
+				GL_COUNTED(glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW));
+				GL_COUNTED(glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &FleetMatrices[0]));
+				fleetUploaded = true;
+			}
+			for (int k = 0; k < 4; k++)
+				GL_COUNTED(glVertexAttribPointer(7 + k, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid*)(packet.InstanceOffset + sizeof(glm::vec4) * k)));
+			setObjectIndex(packet.Slot);
+			GL_COUNTED(glDrawElementsInstancedBaseVertex(GL_TRIANGLES, packet.Count, GL_UNSIGNED_SHORT,
+				(void*)(sizeof(GLushort) * packet.First), packet.Instances, packet.BaseVertex));
+			break;
+		case PACKET_PROJECTILES:
+			GL_COUNTED(glBindBuffer(GL_ARRAY_BUFFER, ProjectileBufferId));
+			GL_COUNTED(glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * packet.Instances, &RenderProjX[0]));
+			GL_COUNTED(glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * MaxProjectiles, sizeof(float) * packet.Instances, &RenderProjY[0]));
+			GL_COUNTED(glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * MaxProjectiles * 2, sizeof(float) * packet.Instances, &RenderProjZ[0]));
+			setObjectIndex(packet.Slot);
+			GL_COUNTED(glDrawElementsInstancedBaseVertex(GL_TRIANGLES, packet.Count, GL_UNSIGNED_SHORT,
+				(void*)(sizeof(GLushort) * packet.First), packet.Instances, packet.BaseVertex));
+			break;
+		}
+	}
+	GL_COUNTED(glBindVertexArray(0));
+	GL_COUNTED(glUseProgram(0));
+	list.Ready = false;
+}
+
+// Starts preparing the next frame, shown at time, on the scene thread. Call once this frame's list is
+// submitted, and only change scene state again after waitRenderList().
+void prepareNextFrame(double time) {
+	waitRenderList();
+	SceneList.Generation = SceneGeneration;
+	ScenePrepThread = std::thread([time] { prepareRenderList(SceneList, time); });
+}
+
+void waitRenderList(void) {
+	if (ScenePrepThread.joinable())
+		ScenePrepThread.join();
+}
+
+void renderScene(void) {
+	//ATTN: DRAW YOUR SCENE HERE. MODIFY/ADAPT WHERE NECESSARY!
+
+	gGLCallCount = 0;
+	gpuTimerBegin(GPU_PASS_SCENE);
+	// A list prepared ahead is kept unless input, a mesh swap or a shader reload came in since
+	waitRenderList();
+	if (!SceneList.Ready || SceneList.Generation != SceneGeneration) {
+		ProfileScope scope(PROF_UPDATE);
+		SceneList.Generation = SceneGeneration;
+		prepareRenderList(SceneList, viewerTime());
+	}
+	profileBegin(PROF_SUBMIT);
+	submitRenderList(SceneList);
+	gGLCallsPerFrame = gGLCallCount;
+	profileEnd(PROF_SUBMIT);
+	gpuTimerEnd();
+	if (FirstFrameMs < 0.0) {
+		FirstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - StreamStart).count();
+		printf("First frame after %.1f ms with %d of %d meshes resident\n", FirstFrameMs,
+			(int)StreamFiles.size() - MeshesPending.load(), (int)StreamFiles.size());
+	}
+}
+
+// GUI on top of the scene, then show the frame
+void presentFrame(void) {
+	// Draw GUI
+	{
+		ProfileScope scope(PROF_GUI);
+		gpuTimerBegin(GPU_PASS_GUI);
+		TwDraw();
+		gpuTimerEnd();
+	}
+
+	// Swap buffers
+	ProfileScope scope(PROF_SWAP);
+	glfwSwapBuffers(window);
+}
+
+void cleanup(void) {
+	// Cleanup VBO and shader
+	for (int i = 0; i < NumObjects; i++) {
+		glDeleteBuffers(1, &VertexBufferId[i]);
+		glDeleteBuffers(1, &IndexBufferId[i]);
+		glDeleteVertexArrays(1, &VertexArrayId[i]);
+	}
+	glDeleteBuffers(1, &MeshArenaVertexBuffer);
+	glDeleteBuffers(1, &MeshArenaIndexBuffer);
+	glDeleteBuffers(1, &DrawSlotIdBuffer);
+	glDeleteBuffers(1, &DrawIndirectBuffer);
+	glDeleteVertexArrays(1, &MeshArenaVAO);
+	for (size_t i = 0; i < StagingFences.size(); i++)
+		glDeleteSync(StagingFences[i].Sync);
+	StagingFences.clear();
+	if (StagingRingBuffer != 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, StagingRingBuffer);
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
+		glDeleteBuffers(1, &StagingRingBuffer);
+		StagingRingData = NULL;
+	}
+	glDeleteBuffers(1, &ProjectileBufferId);
+	glDeleteVertexArrays(1, &ProjectileVAO);
+	glDeleteBuffers(1, &FleetMatrixBuffer);
+	glDeleteVertexArrays(1, &FleetVAO);
+	glDeleteBuffers(1, &FrameUniformBufferId);
+	glDeleteBuffers(1, &ObjectUniformBufferId);
+	glDeleteProgram(programID);
+	if (PendingProgram != 0)
+		glDeleteProgram(PendingProgram);
+	arenaRelease(LoadArena);
+
+	if (Headless) {
+		shutdownHeadless();
+		return;
+	}
+	// Close OpenGL window and terminate GLFW
+	glfwTerminate();
+}
+
+// Alternative way of triggering functions on keyboard events
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	// ATTN: MODIFY AS APPROPRIATE
+	// Only records commands; they are applied by applyCommands() at the start of the next frame
+	InputCommand cmd = { -1, 0 };
+	if (action == GLFW_PRESS) {
+		switch (key)
+		{
+		case GLFW_KEY_C:
+			cmd.Type = CMD_SELECT;
+			cmd.Arg = 'C';
+			break;
+		case GLFW_KEY_P:
+			cmd.Type = CMD_SELECT;
+			cmd.Arg = 'P';
+			break;
+		case GLFW_KEY_B:
+			cmd.Type = CMD_SELECT;
+			cmd.Arg = 'B';
+			break;
+		case GLFW_KEY_T:
+			cmd.Type = CMD_SELECT;
+			cmd.Arg = 'T';
+			break;
+		case GLFW_KEY_S:
+			pushCommand({ CMD_SELECT, 'S' });
+			cmd.Type = CMD_FIRE;
+			break;
+		case GLFW_KEY_1:
+			cmd.Type = CMD_SELECT;
+			cmd.Arg = '1';
+			break;
+		case GLFW_KEY_2:
+			cmd.Type = CMD_SELECT;
+			cmd.Arg = '2';
+			break;
+		case GLFW_KEY_LEFT_SHIFT:
+		case GLFW_KEY_RIGHT_SHIFT:
+			cmd.Type = CMD_SHIFT;
+			cmd.Arg = 1;
+			break;
+		default:
+			break;
+		}
+	}
+	// Arrow keys step on the initial press and on every auto-repeat
+	if (action == GLFW_PRESS || action == GLFW_REPEAT) {
+		switch (key)
+		{
+		case GLFW_KEY_UP:
+		case GLFW_KEY_DOWN:
+		case GLFW_KEY_LEFT:
+		case GLFW_KEY_RIGHT:
+			cmd.Type = CMD_STEP;
+			cmd.Arg = key;
+			break;
+		default:
+			break;
+		}
+	}
+	if (action == GLFW_RELEASE) {
+		switch (key)
+		{
+		case GLFW_KEY_LEFT_SHIFT:
+		case GLFW_KEY_RIGHT_SHIFT:
+			cmd.Type = CMD_SHIFT;
+			cmd.Arg = 0;
+			break;
+		default:
+			break;
+		}
+	}
+	if (cmd.Type >= 0)
+		pushCommand(cmd);
+}
+
+void projectile() {
+	std::lock_guard<std::mutex> lock(SimInputMutex);
+	applyInput(CMD_FIRE, 0);
+}
+
+//-- PROJECTILES --//
+
+// Second VAO over the mesh arena with per-instance x/y/z offsets in attributes 3-5.
+// Other VAOs leave those attributes disabled, so their offsets read as 0.
+void createProjectiles(void) {
+	ProjPosX.resize(MaxProjectiles);
+	ProjPosY.resize(MaxProjectiles);
+	ProjPosZ.resize(MaxProjectiles);
+	ProjPrevX.resize(MaxProjectiles);
+	ProjPrevY.resize(MaxProjectiles);
+	ProjPrevZ.resize(MaxProjectiles);
+	RenderProjX.resize(MaxProjectiles);
+	RenderProjY.resize(MaxProjectiles);
+	RenderProjZ.resize(MaxProjectiles);
+	for (int i = 0; i < 3; i++) {
+		Snapshots[i].NumProjectiles = 0;
+		Snapshots[i].PrevX.resize(MaxProjectiles);
+		Snapshots[i].PrevY.resize(MaxProjectiles);
+		Snapshots[i].PrevZ.resize(MaxProjectiles);
+		Snapshots[i].X.resize(MaxProjectiles);
+		Snapshots[i].Y.resize(MaxProjectiles);
+		Snapshots[i].Z.resize(MaxProjectiles);
+	}
+	ProjVelX.resize(MaxProjectiles);
+	ProjVelY.resize(MaxProjectiles);
+	ProjVelZ.resize(MaxProjectiles);
+	ProjLife.resize(MaxProjectiles);
+
+	glGenVertexArrays(1, &ProjectileVAO);
+	attachMeshArena(ProjectileVAO);
+	glBindVertexArray(ProjectileVAO);
+
+	glGenBuffers(1, &ProjectileBufferId);
+	glBindBuffer(GL_ARRAY_BUFFER, ProjectileBufferId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * MaxProjectiles * 3, NULL, GL_STREAM_DRAW);
+	for (int k = 0; k < 3; k++) {
+		glVertexAttribPointer(3 + k, 1, GL_FLOAT, GL_FALSE, sizeof(float), (GLvoid*)(sizeof(float) * MaxProjectiles * k));
+		glVertexAttribDivisor(3 + k, 1);
+		glEnableVertexAttribArray(3 + k);
+	}
+	glBindVertexArray(0);
+}
+
+static inline float projectileRandom(void) {
+	// xorshift32, deterministic so runs can be reproduced
+	ProjectileSeed ^= ProjectileSeed << 13;
+	ProjectileSeed ^= ProjectileSeed >> 17;
+	ProjectileSeed ^= ProjectileSeed << 5;
+	return (ProjectileSeed & 0xFFFFFF) / 16777216.0f - 0.5f;
+}
+
+// Spawns count solids at the pen tip, fired along the pen with a little spread
+void spawnProjectiles(int count, const JointState &joints) {
+	glm::mat4 tip = glm::translate(nodeMatrixFromState(NODE_SOLID, joints), glm::vec3(0.0f, -0.1f, 0.0f));
+	glm::vec3 dir = -glm::normalize(glm::vec3(tip[1]));
+	count = std::min(count, MaxProjectiles - NumProjectiles);
+	for (int i = 0; i < count; i++) {
+		int p = NumProjectiles++;
+		ProjPosX[p] = tip[3].x;
+		ProjPosY[p] = tip[3].y;
+		ProjPosZ[p] = tip[3].z;
+		ProjPrevX[p] = tip[3].x;
+		ProjPrevY[p] = tip[3].y;
+		ProjPrevZ[p] = tip[3].z;
+		ProjVelX[p] = (dir.x + projectileRandom() * 0.3f) * ProjectileSpeed;
+		ProjVelY[p] = (dir.y + projectileRandom() * 0.3f) * ProjectileSpeed;
+		ProjVelZ[p] = (dir.z + projectileRandom() * 0.3f) * ProjectileSpeed;
+		ProjLife[p] = ProjectileLifetime;
+	}
+}
+
+// Integrates every live solid, then removes the ones that reached the ground or expired in one
+// compaction pass (swap with the last live entry)
+void updateProjectiles(float dt) {
+	int n = NumProjectiles;
+
+	// Branch-free so the compiler can vectorize it. The restrict pointers only live in this block;
+	// the compaction below writes the same arrays through their names.
+	{
+		float* __restrict px = &ProjPosX[0];
+		float* __restrict py = &ProjPosY[0];
+		float* __restrict pz = &ProjPosZ[0];
+		float* __restrict prevx = &ProjPrevX[0];
+		float* __restrict prevy = &ProjPrevY[0];
+		float* __restrict prevz = &ProjPrevZ[0];
+		const float* __restrict vx = &ProjVelX[0];
+		float* __restrict vy = &ProjVelY[0];
+		const float* __restrict vz = &ProjVelZ[0];
+		float* __restrict life = &ProjLife[0];
+		for (int i = 0; i < n; i++) {
+			prevx[i] = px[i];
+			prevy[i] = py[i];
+			prevz[i] = pz[i];
+			vy[i] -= Gravity * dt;
+			px[i] += vx[i] * dt;
+			py[i] += vy[i] * dt;
+			pz[i] += vz[i] * dt;
+			life[i] -= dt;
+		}
+	}
+
+	for (int i = 0; i < n; ) {
+		if (ProjPosY[i] > 0.0f && ProjLife[i] > 0.0f) {
+			i++;
+			continue;
+		}
+		n--;
+		ProjPosX[i] = ProjPosX[n];
+		ProjPosY[i] = ProjPosY[n];
+		ProjPosZ[i] = ProjPosZ[n];
+		ProjPrevX[i] = ProjPrevX[n];
+		ProjPrevY[i] = ProjPrevY[n];
+		ProjPrevZ[i] = ProjPrevZ[n];
+		ProjVelX[i] = ProjVelX[n];
+		ProjVelY[i] = ProjVelY[n];
+		ProjVelZ[i] = ProjVelZ[n];
+		ProjLife[i] = ProjLife[n];
+	}
+	NumProjectiles = n;
+}
+
+//-- SIMULATION --//
+
+static void publishSnapshot(double time, const JointState &joints) {
+	std::lock_guard<std::mutex> lock(SnapshotMutex);
+	int slot = 0;
+	while (slot == LatestSnapshot || slot == PreviousSnapshot)
+		slot++;
+	SimSnapshot &snap = Snapshots[slot];
+	snap.Time = time;
+	snap.Joints = joints;
+	snap.NumProjectiles = NumProjectiles;
+	size_t bytes = sizeof(float) * NumProjectiles;
+	memcpy(&snap.PrevX[0], &ProjPrevX[0], bytes);
+	memcpy(&snap.PrevY[0], &ProjPrevY[0], bytes);
+	memcpy(&snap.PrevZ[0], &ProjPrevZ[0], bytes);
+	memcpy(&snap.X[0], &ProjPosX[0], bytes);
+	memcpy(&snap.Y[0], &ProjPosY[0], bytes);
+	memcpy(&snap.Z[0], &ProjPosZ[0], bytes);
+	PreviousSnapshot = HaveSnapshot ? LatestSnapshot : slot;
+	LatestSnapshot = slot;
+	HaveSnapshot = true;
+}
+
+// One tick: take the input state, spawn and integrate projectiles
+static void simulationTick(double time, float dt) {
+	JointState joints;
+	int spawns;
+	unsigned tick;
+	float cameraSide, cameraUp;
+	{
+		std::lock_guard<std::mutex> lock(SimInputMutex);
+		if (Replaying)
+			replayInputs();
+		if (TrajectoryStep >= 0)
+			playTrajectoryStep();
+		joints = currentJoints();
+		spawns = PendingSpawns + (FireHeld ? ProjectileFirePerTick : 0);
+		PendingSpawns = 0;
+		tick = SimTicks++;
+		cameraSide = rot_camera_side;
+		cameraUp = rot_camera_up;
+	}
+	updateProjectiles(dt);
+	if (spawns > 0)
+		spawnProjectiles(spawns, joints);
+	if ((RecordPath != NULL || Replaying) && (tick + 1) % ReplayCheckpointTicks == 0)
+		checkpointReplay(tick, joints, cameraSide, cameraUp);
+	publishSnapshot(time, joints);
+}
+
+// Runs every tick due by now, but never more than a quarter second's worth of catching up
+void advanceSimulation(double now) {
+	const double dt = 1.0 / SimTickRate;
+	if (now - SimTime > 0.25)
+		SimTime = now - 0.25;
+	while (SimTime + dt <= now) {
+		SimTime += dt;
+		simulationTick(SimTime, (float)dt);
+	}
+}
+
+static void simulationMain(void) {
+	while (SimRunning) {
+		advanceSimulation(viewerTime());
+		std::this_thread::sleep_for(std::chrono::microseconds((long long)((SimTime + 1.0 / SimTickRate - viewerTime()) * 1e6)));
+	}
+}
+
+// Publishes the starting state; the thread is only started for interactive runs, headless runs
+// and replays call advanceSimulation() themselves so every frame sees the same ticks
+void startSimulation(void) {
+	{
+		std::lock_guard<std::mutex> lock(SimInputMutex);
+		RenderJoints = currentJoints();
+	}
+	SimTime = viewerTime();
+	publishSnapshot(SimTime, RenderJoints);
+	if (Headless || Replaying)
+		return;
+	SimRunning = true;
+	SimThread = std::thread(simulationMain);
+}
+
+void stopSimulation(void) {
+	SimRunning = false;
+	if (SimThread.joinable())
+		SimThread.join();
+}
+
+// Fills RenderJoints and the render projectile arrays with the state one tick behind now,
+// interpolated between the last two snapshots
+void interpolateSnapshots(double now) {
+	std::lock_guard<std::mutex> lock(SnapshotMutex);
+	if (!HaveSnapshot)
+		return;
+	const SimSnapshot &prev = Snapshots[PreviousSnapshot];
+	const SimSnapshot &last = Snapshots[LatestSnapshot];
+	double span = last.Time - prev.Time;
+	float alpha = span > 0.0 ? (float)((now - 1.0 / SimTickRate - prev.Time) / span) : 1.0f;
+	alpha = alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+
+	const float* a = &prev.Joints.trans_base_x;
+	const float* b = &last.Joints.trans_base_x;
+	float* out = &RenderJoints.trans_base_x;
+	for (size_t k = 0; k < sizeof(JointState) / sizeof(float); k++)
+		out[k] = a[k] + (b[k] - a[k]) * alpha;
+
+	// The latest snapshot keeps each solid's previous position, so no matching between snapshots is needed
+	int n = last.NumProjectiles;
+	for (int i = 0; i < n; i++) {
+		RenderProjX[i] = last.PrevX[i] + (last.X[i] - last.PrevX[i]) * alpha;
+		RenderProjY[i] = last.PrevY[i] + (last.Y[i] - last.PrevY[i]) * alpha;
+		RenderProjZ[i] = last.PrevZ[i] + (last.Z[i] - last.PrevZ[i]) * alpha;
+	}
+	NumRenderProjectiles = n;
+}
+
+void key_up() {
+	switch (selection)
+	{
+	case 'C':
+		if (rot_camera_up > PI / 10) rot_camera_up -= PI / 10;
+		break;
+	case 'B':
+		trans_base_x -= 0.1;
+		break;
+	case 'T':
+		break;
+	case '1':
+		if (rot_arm1 <= (3 * PI / 4)) rot_arm1 += PI / 10;
+		break;
+	case '2':
+		rot_arm2 += PI / 10;
+		break;
+	case 'P':
+		rot_pen_lat += PI / 10;
+		break;
+	default:
+		break;
+	}
+}
+
+void key_down() {
+	switch (selection)
+	{
+	case 'C':
+		if (rot_camera_up < 9 * PI / 10) rot_camera_up += PI / 10;
+		break;
+	case 'B':
+		trans_base_x += 0.1;
+		break;
+	case 'T':
+		break;
+	case '1':
+		if (rot_arm1 >= (-3 * PI / 4)) rot_arm1 -= PI / 10;
+		break;
+	case '2':
+		rot_arm2 -= PI / 10;
+		break;
+	case 'P':
+		rot_pen_lat -= PI / 10;
+		break;
+	default:
+		break;
+	}
+}
+
+void key_left() {
+	switch (selection)
+	{
+	case 'C':
+		rot_camera_side -= PI/10;
+		break;
+	case 'B':
+		trans_base_z += 0.1;
+		break;
+	case 'T':
+		rot_top -= PI / 10;
+		break;
+	case '1':
+		break;
+	case '2':
+		break;
+	case 'P':
+		if (shift_press == true) rot_pen_twist -= PI / 10;
+		else rot_pen_long -= PI / 10;
+		break;
+	default:
+		break;
+	}
+}
+
+void key_right() {
+	switch (selection)
+	{
+	case 'C':
+		rot_camera_side += PI/10;
+		break;
+	case 'B':
+		trans_base_z -= 0.1;
+		break;
+	case 'T':
+		rot_top += PI / 10;
+		break;
+	case '1':
+		break;
+	case '2':
+		break;
+	case 'P':
+		if (shift_press == true) rot_pen_twist += PI / 10;
+		else rot_pen_long += PI / 10;
+		break;
+	default:
+		break;
+	}
+}
+
+// Alternative way of triggering functions on mouse click events
+static void mouseCallback(GLFWwindow* window, int button, int action, int mods) {
+	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+		InputCommand cmd = { CMD_PICK, 0 };
+		pushCommand(cmd);
+	}
+}
+
+//-- INPUT COMMANDS --//
+
+// Returns false (and drops the command) when the consumer has fallen a full queue behind
+bool pushCommand(const InputCommand &cmd) {
+	unsigned tail = CommandTail.load(std::memory_order_relaxed);
+	if (tail - CommandHead.load(std::memory_order_acquire) == CommandQueueSize) {
+		DroppedCommands++;
+		return false;
+	}
+	CommandQueue[tail & (CommandQueueSize - 1)] = cmd;
+	CommandTail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+// Applies one input to the shared state and adds it to the recording, if any. Live input and
+// replays both come through here; called with SimInputMutex held.
+void applyInput(int type, int arg) {
+	switch (type)
+	{
+	case CMD_SELECT:
+		selection = (char)arg;
+		break;
+	case CMD_SHIFT:
+		shift_press = arg != 0;
+		break;
+	case CMD_STEP: {
+		JointState from = currentJoints();
+		switch (arg)
+		{
+		case GLFW_KEY_UP:
+			key_up();
+			break;
+		case GLFW_KEY_DOWN:
+			key_down();
+			break;
+		case GLFW_KEY_LEFT:
+			key_left();
+			break;
+		case GLFW_KEY_RIGHT:
+			key_right();
+			break;
+		default:
+			break;
+		}
+		JointState to = currentJoints();
+		if (!clampMove(from, to))
+			setJoints(to);
+		break;
+	}
+	case CMD_FIRE:
+		PendingSpawns += ProjectileBurst;
+		break;
+	case CMD_HOLD_FIRE:
+		FireHeld = arg != 0;
+		break;
+	default:
+		return;
+	}
+	if (RecordPath != NULL) {
+		RecordedInput input = { SimTicks, type, arg };
+		ReplayInputs.push_back(input);
+	}
+}
+
+static void applySteps(int key, int count) {
+	if (count == 0)
+		return;
+	// Steps are applied one at a time so the per-step joint limits still hold
+	std::lock_guard<std::mutex> lock(SimInputMutex);
+	for (int i = 0; i < count; i++)
+		applyInput(CMD_STEP, key);
+}
+
+// Drains everything queued since the last frame. Consecutive steps of the same arrow key are merged
+// into one locked update; selection and shift changes split runs since they change what a step does.
+void applyCommands(void) {
+	unsigned head = CommandHead.load(std::memory_order_relaxed);
+	unsigned tail = CommandTail.load(std::memory_order_acquire);
+	// Replays ignore live input
+	if (Replaying) {
+		CommandHead.store(tail, std::memory_order_release);
+		return;
+	}
+	if (head != tail)
+		SceneGeneration++;	// a list prepared before this input shows the old camera and selection
+	int stepKey = 0, stepCount = 0, fires = 0;
+	bool pick = false;
+
+	for (; head != tail; head++) {
+		const InputCommand &cmd = CommandQueue[head & (CommandQueueSize - 1)];
+		if (cmd.Type == CMD_STEP && cmd.Arg == stepKey) {
+			stepCount++;
+			continue;
+		}
+		applySteps(stepKey, stepCount);
+		stepKey = 0;
+		stepCount = 0;
+		switch (cmd.Type)
+		{
+		case CMD_SELECT:
+		case CMD_SHIFT: {
+			std::lock_guard<std::mutex> lock(SimInputMutex);
+			applyInput(cmd.Type, cmd.Arg);
+			break;
+		}
+		case CMD_STEP:
+			stepKey = cmd.Arg;
+			stepCount = 1;
+			break;
+		case CMD_FIRE:
+			fires++;
+			break;
+		case CMD_PICK:
+			pick = true;
+			break;
+		default:
+			break;
+		}
+	}
+	applySteps(stepKey, stepCount);
+	CommandHead.store(head, std::memory_order_release);
+
+	for (int i = 0; i < fires; i++)
+		projectile();
+	if (pick)
+		pickObject();
+}
+
+//-- RECORD AND REPLAY --//
+
+static ReplayState replayState(const JointState &joints, float cameraSide, float cameraUp) {
+	ReplayState state;
+	state.ProjectileHash = 14695981039346656037ULL;
+	size_t bytes = sizeof(float) * NumProjectiles;
+	if (NumProjectiles > 0) {
+		state.ProjectileHash = fnv1a(&ProjPosX[0], bytes, state.ProjectileHash);
+		state.ProjectileHash = fnv1a(&ProjPosY[0], bytes, state.ProjectileHash);
+		state.ProjectileHash = fnv1a(&ProjPosZ[0], bytes, state.ProjectileHash);
+	}
+	state.Joints = joints;
+	state.CameraSide = cameraSide;
+	state.CameraUp = cameraUp;
+	state.NumProjectiles = NumProjectiles;
+	state.ProjectileSeed = ProjectileSeed;
+	return state;
+}
+
+// Saves the state at the end of a tick, or compares it with the recording when replaying. Called
+// by the simulation once the tick's projectiles have moved.
+void checkpointReplay(unsigned tick, const JointState &joints, float cameraSide, float cameraUp) {
+	ReplayState state = replayState(joints, cameraSide, cameraUp);
+	if (!Replaying) {
+		ReplayCheckpoint checkpoint = { tick, state };
+		ReplayCheckpoints.push_back(checkpoint);
+		return;
+	}
+	if (NextReplayCheckpoint >= ReplayCheckpoints.size() || ReplayCheckpoints[NextReplayCheckpoint].Tick != tick)
+		return;
+	const ReplayState &expected = ReplayCheckpoints[NextReplayCheckpoint++].State;
+	// The state has no padding, so bytes compare exactly like the recorded floats
+	if (memcmp(&expected, &state, sizeof(state)) == 0) {
+		ReplayMatches++;
+		return;
+	}
+	if (ReplayMismatches++ == 0)
+		fprintf(stderr, "Replay diverges by tick %u (%.2f s):%s%s%s\n", tick, tick / SimTickRate,
+			memcmp(&expected.Joints, &state.Joints, sizeof(JointState)) != 0 ? " joints" : "",
+			expected.CameraSide != state.CameraSide || expected.CameraUp != state.CameraUp ? " camera" : "",
+			expected.ProjectileHash != state.ProjectileHash || expected.NumProjectiles != state.NumProjectiles ||
+			expected.ProjectileSeed != state.ProjectileSeed ? " projectiles" : "");
+}
+
+// Applies the recorded inputs first seen by the coming tick; called by the simulation with
+// SimInputMutex held
+void replayInputs(void) {
+	while (NextReplayInput < ReplayInputs.size() && ReplayInputs[NextReplayInput].Tick <= SimTicks) {
+		const RecordedInput &input = ReplayInputs[NextReplayInput++];
+		applyInput(input.Type, input.Arg);
+	}
+}
+
+// Reads a recording and puts the viewer in its starting state
+bool loadRecording(const char* path) {
+	FILE* in = fopen(path, "rb");
+	if (in == NULL) {
+		fprintf(stderr, "Cannot open %s\n", path);
+		return false;
+	}
+	ReplayHeader &header = ReplayStart;
+	bool ok = fread(&header, sizeof(header), 1, in) == 1 && memcmp(header.Magic, "MVRP", 4) == 0 &&
+		header.Version == ReplayVersion;
+	std::vector<float> frameMs;
+	if (ok) {
+		ReplayInputs.resize(header.NumInputs);
+		ReplayCheckpoints.resize(header.NumCheckpoints);
+		frameMs.resize(header.NumFrames);
+		ok = (header.NumInputs == 0 || fread(&ReplayInputs[0], sizeof(RecordedInput), header.NumInputs, in) == header.NumInputs) &&
+			(header.NumCheckpoints == 0 || fread(&ReplayCheckpoints[0], sizeof(ReplayCheckpoint), header.NumCheckpoints, in) == header.NumCheckpoints) &&
+			(header.NumFrames == 0 || fread(&frameMs[0], sizeof(float), header.NumFrames, in) == header.NumFrames);
+	}
+	fclose(in);
+	if (!ok) {
+		fprintf(stderr, "%s is not a version %u recording\n", path, ReplayVersion);
+		return false;
+	}
+	RecordedFrameMs.assign(frameMs.begin(), frameMs.end());
+
+	const ReplayState &start = header.Start;
+	selection = (char)header.Selection;
+	shift_press = header.ShiftPress != 0;
+	setJoints(start.Joints);
+	rot_camera_side = start.CameraSide;
+	rot_camera_up = start.CameraUp;
+	ProjectileSeed = start.ProjectileSeed;
+	Replaying = true;
+	printf("%s: %.1f s, %u inputs, %u checkpoints\n", path, header.Ticks / SimTickRate, header.NumInputs, header.NumCheckpoints);
+	return true;
+}
+
+// Notes the starting state; call just before startSimulation()
+void startRecording(void) {
+	std::lock_guard<std::mutex> lock(SimInputMutex);
+	memset(&ReplayStart, 0, sizeof(ReplayStart));
+	memcpy(ReplayStart.Magic, "MVRP", 4);
+	ReplayStart.Version = ReplayVersion;
+	ReplayStart.Selection = selection;
+	ReplayStart.ShiftPress = shift_press;
+	ReplayStart.Start = replayState(currentJoints(), rot_camera_side, rot_camera_up);
+}
+
+// Writes the recording once the simulation has stopped
+bool writeRecording(const char* path, const std::vector<double> &frameMs) {
+	FILE* out = fopen(path, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "Cannot write %s\n", path);
+		return false;
+	}
+	std::vector<float> frames(frameMs.begin(), frameMs.end());
+	ReplayHeader &header = ReplayStart;
+	header.Ticks = SimTicks;
+	header.NumInputs = (unsigned)ReplayInputs.size();
+	header.NumCheckpoints = (unsigned)ReplayCheckpoints.size();
+	header.NumFrames = (unsigned)frames.size();
+	fwrite(&header, sizeof(header), 1, out);
+	if (!ReplayInputs.empty())
+		fwrite(&ReplayInputs[0], sizeof(RecordedInput), ReplayInputs.size(), out);
+	if (!ReplayCheckpoints.empty())
+		fwrite(&ReplayCheckpoints[0], sizeof(ReplayCheckpoint), ReplayCheckpoints.size(), out);
+	if (!frames.empty())
+		fwrite(&frames[0], sizeof(float), frames.size(), out);
+	bool ok = ferror(out) == 0;
+	fclose(out);
+	if (!ok)
+		fprintf(stderr, "Cannot write %s\n", path);
+	else
+		printf("Recorded %.1f s, %u inputs, %u checkpoints to %s\n", SimTicks / SimTickRate, header.NumInputs, header.NumCheckpoints, path);
+	return ok;
+}
+
+// Frame times of the recording next to the replay's, and whether the checkpoints matched
+void printReplayResult(const std::vector<double> &frameMs) {
+	printf("recorded ");
+	printFrameTimes(RecordedFrameMs);
+	printf("replayed ");
+	printFrameTimes(frameMs);
+	if (SimTicks < ReplayStart.Ticks)
+		printf("Replay stopped at %.1f of %.1f s\n", SimTicks / SimTickRate, ReplayStart.Ticks / SimTickRate);
+	printf("%u of %u checkpoints match\n", ReplayMatches, (unsigned)ReplayCheckpoints.size());
+}
+
+//-- COMMAND LINE --//
+
+// Accepts only a whole non-negative decimal number
+static bool parseCount(const char* arg, int &count) {
+	char* end;
+	long value = strtol(arg, &end, 10);
+	if (end == arg || *end != '\0' || value < 0 || value > INT_MAX)
+		return false;
+	count = (int)value;
+	return true;
+}
+
+static int usage(const char* arg) {
+	fprintf(stderr, "Unknown or incomplete option %s\n", arg);
+	fprintf(stderr, "usage: p2_source [--trace file.json] [--trajectory file.txt] [--fleet arms] [--no-shader-cache] [--pipeline]\n"
+		"                 [--record file | --replay file [--max-speed]]\n"
+		"       p2_source --headless [frames] [--checksum] [--dump prefix] [--trace file.json] [--fleet arms]\n"
+		"                            [--no-shader-cache] [--pipeline]\n"
+		"       p2_source --convert [file.obj ...] | --bench-weld | --bench-obj | --bench-pick | --bench-reload\n"
+		"                 | --bench-ik | --bench-collision [count]\n");
+	return 1;
+}
+
+int main(int argc, char* argv[]) {
+	// TL
+	// ATTN: Refer to https://learnopengl.com/Getting-started/Transformations, https://learnopengl.com/Getting-started/Coordinate-Systems,
+	// and https://learnopengl.com/Getting-started/Camera to familiarize yourself with implementing the camera movement
+
+	// ATTN (Project 3 only): Refer to https://learnopengl.com/Getting-started/Textures to familiarize yourself with mapping a texture
+	// to a given mesh
+
+	// Offline conversion of .obj files to .mbin, no window needed
+	if (argc > 1 && strcmp(argv[1], "--convert") == 0)
+		return convertMeshes(argc - 2, argv + 2);
+	if (argc > 1 && strcmp(argv[1], "--bench-weld") == 0)
+		return benchWeld(argc > 2 ? atoi(argv[2]) : 50000);
+	if (argc > 1 && strcmp(argv[1], "--bench-obj") == 0)
+		return benchParse(argc > 2 ? argv[2] : NULL);
+	if (argc > 1 && strcmp(argv[1], "--bench-pick") == 0)
+		return benchPick();
+	if (argc > 1 && strcmp(argv[1], "--bench-reload") == 0)
+		return benchReload(argc > 2 ? atoi(argv[2]) : 100);
+	if (argc > 1 && strcmp(argv[1], "--bench-ik") == 0)
+		return benchIK(argc > 2 ? atoi(argv[2]) : 100000);
+	if (argc > 1 && strcmp(argv[1], "--bench-collision") == 0)
+		return benchCollision(argc > 2 ? atoi(argv[2]) : 100000);
+	// Offscreen benchmark: --headless [frames] [--checksum] [--dump prefix] [--trace file.json] [--fleet arms]
+	// [--no-shader-cache] [--pipeline]
+	if (argc > 1 && strcmp(argv[1], "--headless") == 0) {
+		int frames = 600, arms = 0;
+		const char* dumpPrefix = NULL;
+		bool checksums = false;
+		for (int i = 2; i < argc; i++) {
+			if (strcmp(argv[i], "--checksum") == 0)
+				checksums = true;
+			else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc)
+				dumpPrefix = argv[++i];
+			else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+				TracePath = argv[++i];
+			else if (strcmp(argv[i], "--fleet") == 0 && i + 1 < argc && parseCount(argv[i + 1], arms))
+				i++;
+			else if (strcmp(argv[i], "--no-shader-cache") == 0)
+				UseProgramCache = false;
+			else if (strcmp(argv[i], "--pipeline") == 0)
+				PipelineScene = true;
+			else if (!parseCount(argv[i], frames))
+				return usage(argv[i]);
+		}
+		if (arms > 0)
+			createFleet(arms);
+		int result = runHeadless(frames, dumpPrefix, checksums);
+		if (TracePath != NULL && !writeTrace(TracePath))
+			result = 1;
+		return result;
+	}
+	// Interactive options, in any order:
+	//   --trace file.json       records every frame's stages for chrome://tracing
+	//   --trajectory file.txt   moves the pen tip through the file's waypoints, one per tick
+	//   --no-shader-cache       compiles the shaders from source even when a cached program binary matches
+	//   --pipeline              prepares each frame's render list on the scene thread while the previous frame is shown
+	//   --fleet N               surrounds the arm with N more, each posed on its own
+	//   --record session.rec    saves the session's input
+	//   --replay session.rec    plays a recording back, ignoring live input, and checks that the
+	//                           simulation ends up in the same states; --max-speed replays without vsync
+	const char* trajectoryPath = NULL;
+	const char* replayPath = NULL;
+	bool maxSpeed = false;
+	int arms = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			TracePath = argv[++i];
+		else if (strcmp(argv[i], "--trajectory") == 0 && i + 1 < argc)
+			trajectoryPath = argv[++i];
+		else if (strcmp(argv[i], "--no-shader-cache") == 0)
+			UseProgramCache = false;
+		else if (strcmp(argv[i], "--pipeline") == 0)
+			PipelineScene = true;
+		else if (strcmp(argv[i], "--fleet") == 0 && i + 1 < argc && parseCount(argv[i + 1], arms))
+			i++;
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			RecordPath = argv[++i];
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			replayPath = argv[++i];
+		else if (strcmp(argv[i], "--max-speed") == 0)
+			maxSpeed = true;
+		else
+			return usage(argv[i]);
+	}
+	if (RecordPath != NULL && replayPath != NULL) {
+		fprintf(stderr, "--record and --replay cannot be combined\n");
+		return 1;
+	}
+	if (maxSpeed && replayPath == NULL) {
+		fprintf(stderr, "--max-speed only applies to --replay\n");
+		return 1;
+	}
+	if (trajectoryPath != NULL && !loadTrajectory(trajectoryPath))
+		return 1;
+	if (arms > 0)
+		createFleet(arms);
+	if (replayPath != NULL) {
+		if (!loadRecording(replayPath))
+			return 1;
+		ReplayMaxSpeed = maxSpeed;
+	}
+
+	// Initialize window
+	int errorCode = initWindow();
+	if (errorCode != 0)
+		return errorCode;
+
+	if (ReplayMaxSpeed)
+		glfwSwapInterval(0);
+
+	// Initialize OpenGL pipeline
+	initOpenGL();
+	// Self collision checks need every hull, so recordings and replays start with all meshes in
+	if (RecordPath != NULL || Replaying)
+		finishStreaming();
+	if (RecordPath != NULL)
+		startRecording();
+	startSimulation();
+	startHotReload();
+
+	// For speed computation
+	double lastTime = glfwGetTime();
+	int nbFrames = 0;
+	std::vector<double> frameMs;	// kept for recordings and replays
+	double lastRenderTime = viewerTime();
+	do {
+		std::chrono::high_resolution_clock::time_point frameStart = std::chrono::high_resolution_clock::now();
+		profileBegin(PROF_FRAME);
+		// Input and reloads change what the scene thread reads
+		waitRenderList();
+		// Measure speed
+		double currentTime = glfwGetTime();
+		nbFrames++;
+		if (currentTime - lastTime >= 1.0){ // If last prinf() was more than 1sec ago
+			printf("%f ms/frame\n", 1000.0 / double(nbFrames));
+			nbFrames = 0;
+			lastTime += 1.0;
+		}
+
+		// Gather this frame's input and apply it before drawing
+		{
+			ProfileScope scope(PROF_INPUT);
+			glfwPollEvents();
+			applyCommands();
+			applyReloads();
+
+			// Holding S keeps firing
+			std::lock_guard<std::mutex> lock(SimInputMutex);
+			bool held = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+			if (held != FireHeld && !Replaying)
+				applyInput(CMD_HOLD_FIRE, held);
+		}
+		// Replays tick the simulation here, so the recorded inputs land on the same ticks
+		if (Replaying) {
+			if (ReplayMaxSpeed)
+				HeadlessClock += 1.0 / HeadlessFrameRate;
+			advanceSimulation(viewerTime());
+		}
+
+		// DRAWING POINTS
+		renderScene();
+		// The next frame is prepared for one frame interval from now while this one is shown
+		double renderTime = viewerTime();
+		if (PipelineScene)
+			prepareNextFrame(2.0 * renderTime - lastRenderTime);
+		lastRenderTime = renderTime;
+		presentFrame();
+		profileEnd(PROF_FRAME);
+		profileFrameEnd();
+		if (RecordPath != NULL || Replaying)
+			frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count());
+
+	} // Check if the ESC key was pressed, the window was closed or the replay is over
+	while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
+	glfwWindowShouldClose(window) == 0 && !(Replaying && SimTicks >= ReplayStart.Ticks));
+
+	waitRenderList();
+	stopSimulation();
+	stopHotReload();
+	stopStreaming();
+	if (RecordPath != NULL)
+		writeRecording(RecordPath, frameMs);
+	if (Replaying)
+		printReplayResult(frameMs);
+	cleanup();
+	stopWorkers();
+	if (TracePath != NULL)
+		writeTrace(TracePath);
+
+	return 0;
 }
\ No newline at end of file